@@ -0,0 +1,47 @@
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include "include/fingerprint.h"
+
+namespace {
+constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+}  // namespace
+
+Fingerprint::Fingerprint() : hash_(kFnvOffsetBasis) {}
+
+Fingerprint& Fingerprint::Update(const std::string& data) {
+  // length prefix keeps ("ab", "c") and ("a", "bc") apart
+  std::string size = std::to_string(data.size()) + ':';
+  UpdateBytes(size.data(), size.size());
+  UpdateBytes(data.data(), data.size());
+  return *this;
+}
+
+Fingerprint& Fingerprint::UpdateFile(const std::filesystem::path& path) {
+  std::ifstream fin(path, std::ios::binary);
+  if (!fin.is_open()) {
+    std::ostringstream err;
+    err << "failed to open " << path << " for fingerprinting";
+    throw std::runtime_error(err.str());
+  }
+  std::vector<char> buf(1 << 16);
+  while (fin.read(buf.data(), buf.size()) || fin.gcount() > 0) {
+    UpdateBytes(buf.data(), fin.gcount());
+  }
+  return *this;
+}
+
+std::string Fingerprint::ToString() const {
+  std::ostringstream ss;
+  ss << std::hex << std::setw(16) << std::setfill('0') << hash_;
+  return ss.str();
+}
+
+void Fingerprint::UpdateBytes(const char* data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    hash_ ^= static_cast<unsigned char>(data[i]);
+    hash_ *= kFnvPrime;
+  }
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// Incremental 64-bit FNV-1a hash, stable across runs and machines.
+// Used to name content-addressed files on disk.
+class Fingerprint {
+ public:
+  Fingerprint();
+  Fingerprint& Update(const std::string& data);
+  Fingerprint& UpdateFile(const std::filesystem::path& path);
+  std::string ToString() const;
+ private:
+  void UpdateBytes(const char* data, size_t size);
+  uint64_t hash_;
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Append-only log of completed job steps.
+// A durable journal syncs every record to disk before Record() returns.
+// Together with SyncOutput() called for the files a step produced, this
+// makes the journal list only steps whose results survived a crash,
+// including a crash of the whole machine.
+class Journal {
+ public:
+  Journal(const std::filesystem::path& path, bool durable);
+
+  // Returns the result recorded for `step`, if it was completed.
+  std::optional<std::string> Find(const std::string& step) const;
+
+  bool IsDone(const std::string& step) const;
+
+  void Record(const std::string& step, const std::string& result = "");
+
+  // Flushes the file or directory at `path` to disk if the journal
+  // is durable. Must be called for every output of a step, and for
+  // the directories they are in, before the step is recorded.
+  void SyncOutput(const std::filesystem::path& path) const;
+
+  ~Journal();
+
+  Journal& operator=(const Journal& p) = delete;
+
+  Journal(const Journal& p) = delete;
+
+ private:
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::string> steps_;
+  bool durable_;
+  int fd_;
+};
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+
+// Removes least recently accessed (by atime) files from `dir` until their
+// total size is at most `max_size`. Dot files are neither counted nor
+// removed, so in-progress temporary files survive.
+// Runs under an exclusive flock() on `dir`/.lock, which makes concurrent
+// trims from several processes safe.
+// Returns the total size left in `dir`.
+uintmax_t TrimDirectoryLru(const std::filesystem::path& dir,
+    uintmax_t max_size);
@@ -0,0 +1,23 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+// Counting semaphore over bytes of memory shared by running tasks.
+class MemoryBudget {
+ public:
+  explicit MemoryBudget(size_t total);
+
+  // Blocks until `amount` bytes are available and takes them.
+  // Requests larger than the whole budget wait for it to be entirely free.
+  // Returns the amount actually taken, to be passed to Release().
+  size_t Acquire(size_t amount);
+
+  void Release(size_t amount);
+
+ private:
+  size_t total_;
+  size_t available_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
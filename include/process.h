@@ -1,9 +1,28 @@
 #pragma once
 #include <filesystem>
 #include <memory>
+#include <optional>
 #include <vector>
 #include <string>
 
+enum class ProcessState {
+  CREATED,
+  RUNNING,
+  TERMINATED,
+};
+
+// Resources a process may use, unset fields are not limited.
+struct ResourceLimits {
+  // bytes of address space, also memory.max if `cgroup` is set
+  std::optional<size_t> memory = std::nullopt;
+  // seconds of CPU time
+  std::optional<size_t> cpu_time = std::nullopt;
+  // delegated cgroup v2 directory to create the process cgroup in
+  std::optional<std::filesystem::path> cgroup = std::nullopt;
+  // pin the process to the least busy CPU it is allowed to run on
+  bool pin_cpu = false;
+};
+
 class Process {
  public:
   Process() {}
@@ -19,12 +38,22 @@ class Process {
 
   virtual void SetOutput(const std::filesystem::path& path) = 0;
 
+  virtual void SetLimits(const ResourceLimits& limits) = 0;
+
   virtual int Wait() = 0;
 
   virtual ~Process() {}
 
   static std::unique_ptr<Process> Create(const std::filesystem::path& path);
 
+  // Creates a process to be run by the worker daemon at `address`.
+  // Input and output files are transferred over the connection, the input
+  // only if the worker doesn't have it yet. `input_fingerprint` saves
+  // fingerprinting the input again if the caller already did.
+  static std::unique_ptr<Process> CreateRemote(const std::string& address,
+      const std::filesystem::path& path,
+      const std::optional<std::string>& input_fingerprint = std::nullopt);
+
   Process& operator=(const Process& p) = delete;
 
   Process(const Process& p) = delete;
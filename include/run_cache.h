@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// Persistent store of intermediate files (map outputs, sorted runs) keyed by
+// a fingerprint of everything they were computed from.
+// Files are shared with the cache through hard links where possible, so
+// restored and stored files must not be modified in place.
+// Trim() keeps the cache under `max_size` bytes by dropping the least
+// recently used files.
+class RunCache {
+ public:
+  RunCache(const std::filesystem::path& dir, uintmax_t max_size);
+
+  // Places the file cached under `key` at `path`.
+  // Returns false, leaving `path` as is, if there is no such file, including
+  // when a concurrent Trim() evicts it.
+  bool Restore(const std::string& key,
+      const std::filesystem::path& path) const;
+
+  // Saves `path` under `key`, replacing the previous file atomically.
+  void Store(const std::string& key, const std::filesystem::path& path) const;
+
+  // Evicts least recently used files until the cache fits its size limit.
+  // Safe to run concurrently from several processes.
+  void Trim() const;
+
+ private:
+  std::filesystem::path dir_;
+  uintmax_t max_size_;
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+// Failure of the connection itself, as opposed to an error the peer reports.
+class ConnectionError : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+// Stream socket exchanging length-prefixed frames.
+// Addresses containing '/' are Unix socket paths, others are HOST:PORT.
+// HOST may be omitted (":PORT") to mean the loopback interface.
+// A listening Unix socket removes its path when destroyed.
+class Socket {
+ public:
+  // Limit for frames other than file contents, which peers are not trusted
+  // to keep small otherwise.
+  static constexpr size_t kMaxControlFrameSize = 1 << 14;
+
+  explicit Socket(int fd);
+
+  static Socket Connect(const std::string& address);
+
+  static Socket Listen(const std::string& address);
+
+  // Waits for a connection. Returns nothing instead once `stop_fd` becomes
+  // readable.
+  std::optional<Socket> Accept(int stop_fd) const;
+
+  void WriteFrame(const std::string& data) const;
+
+  // Throws ConnectionError if the peer closed the connection or sent
+  // a frame longer than `max_size`.
+  std::string ReadFrame(size_t max_size = kMaxControlFrameSize) const;
+
+  // Sends contents of `path` as a sequence of frames ending with an empty one.
+  void SendFile(const std::filesystem::path& path) const;
+
+  // Receives a file sent by SendFile() and writes it to `path`.
+  void ReceiveFile(const std::filesystem::path& path) const;
+
+  Socket(Socket&& s);
+
+  ~Socket();
+
+  Socket& operator=(const Socket& s) = delete;
+
+  Socket(const Socket& s) = delete;
+
+ private:
+  void WriteAll(const char* data, size_t size) const;
+  void ReadAll(char* data, size_t size) const;
+
+  int fd_;
+  std::string unlink_path_;
+};
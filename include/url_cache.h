@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+// On-disk cache of fetched pages keyed by normalized URL.
+// Every entry is a plain file holding the raw response body, so it can be
+// read (or mmap'ed) as is. Entries are published with an atomic rename and
+// evicted in LRU order under an exclusive flock(), which makes the cache
+// safe to share between concurrently running processes.
+class UrlCache {
+ public:
+  UrlCache(const std::filesystem::path& dir,
+      uintmax_t max_size,
+      std::optional<std::chrono::seconds> ttl);
+
+  // Returns cached content for `url` unless it is missing or expired.
+  std::optional<std::string> Get(const std::string& url) const;
+
+  // Stores `content` for `url` and evicts least recently used entries
+  // if the cache grew over its size limit.
+  // The directory is only rescanned once the pages stored since the last
+  // scan could have pushed it over the limit, so concurrent processes may
+  // overshoot it by a fraction of the limit each.
+  void Put(const std::string& url, const std::string& content);
+
+  static std::string NormalizeUrl(const std::string& url);
+
+ private:
+  std::filesystem::path EntryPath(const std::string& url) const;
+  void Evict();
+
+  std::filesystem::path dir_;
+  uintmax_t max_size_;
+  std::optional<std::chrono::seconds> ttl_;
+  // size found by the last scan, nothing until the first Put()
+  std::optional<uintmax_t> known_size_;
+  uintmax_t stored_since_scan_;
+};
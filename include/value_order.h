@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+
+// Interface of value order plugins for `mapreduce reduce --value-order LIB`.
+// A plugin is a shared library exporting mr_compare_values(), which returns
+// a negative number, zero or a positive number if value `a` goes before,
+// together with or after value `b`, like strcmp() does.
+extern "C" int mr_compare_values(const char* a, size_t a_size,
+    const char* b, size_t b_size);
+
+using ValueComparator = decltype(&mr_compare_values);
+
+constexpr char kValueComparatorSymbol[] = "mr_compare_values";
@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Serves tasks sent by Process::CreateRemote() on `address` until SIGTERM
+// or SIGINT, then waits for running tasks and cleans up after itself.
+// Every task runs as a local process in a separate directory, at most
+// twice as many tasks as there are CPUs at a time.
+// Inputs are kept (up to 1 GiB, LRU) under their fingerprints, so a task
+// whose input the worker already has doesn't receive it again; the
+// coordinator sends tasks with the same input to the same worker.
+// Workers don't exchange data with each other: map and reduce are separate
+// jobs joined by a file the coordinator writes, so every partition comes
+// from the coordinator and returns there.
+// Peers are not authenticated, so only executables from `allowed_execs`
+// are run; tasks asking for anything else are rejected.
+void RunWorker(const std::string& address,
+    const std::vector<std::string>& allowed_execs);
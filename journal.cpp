@@ -0,0 +1,89 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "include/journal.h"
+
+Journal::Journal(const std::filesystem::path& path, bool durable) :
+    mutex_(), steps_(), durable_(durable), fd_(-1) {
+  std::ifstream fin(path, std::ios::binary);
+  std::string line;
+  off_t valid_size = 0;
+  // a record without trailing newline was torn by a crash, drop it
+  while (std::getline(fin, line) && !fin.eof()) {
+    valid_size += line.size() + 1;
+    size_t tab_pos = line.find('\t');
+    if (tab_pos == std::string::npos) {
+      steps_[line] = "";
+    } else {
+      steps_[line.substr(0, tab_pos)] = line.substr(tab_pos + 1);
+    }
+  }
+  fin.close();
+
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    std::ostringstream err;
+    err << "failed to open journal " << path << ": " << strerror(errno);
+    throw std::runtime_error(err.str());
+  }
+  if (ftruncate(fd_, valid_size) < 0
+      || lseek(fd_, valid_size, SEEK_SET) < 0) {
+    close(fd_);
+    throw std::runtime_error("failed to truncate journal");
+  }
+}
+
+std::optional<std::string> Journal::Find(const std::string& step) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = steps_.find(step);
+  if (it == steps_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+bool Journal::IsDone(const std::string& step) const {
+  return Find(step).has_value();
+}
+
+void Journal::Record(const std::string& step, const std::string& result) {
+  std::string line = step + '\t' + result + '\n';
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t written = 0;
+  while (written < line.size()) {
+    ssize_t cnt = write(fd_, line.data() + written, line.size() - written);
+    if (cnt < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("failed to write journal record");
+    }
+    written += cnt;
+  }
+  if (durable_ && fdatasync(fd_) < 0) {
+    throw std::runtime_error("failed to sync journal");
+  }
+  steps_[step] = result;
+}
+
+void Journal::SyncOutput(const std::filesystem::path& path) const {
+  if (!durable_) {
+    return;
+  }
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0 || fsync(fd) < 0) {
+    std::ostringstream err;
+    err << "failed to sync " << path << ": " << strerror(errno);
+    if (fd >= 0) {
+      close(fd);
+    }
+    throw std::runtime_error(err.str());
+  }
+  close(fd);
+}
+
+Journal::~Journal() {
+  close(fd_);
+}
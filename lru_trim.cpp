@@ -0,0 +1,74 @@
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "include/lru_trim.h"
+
+namespace {
+
+constexpr char kLockFileName[] = ".lock";
+
+}  // namespace
+
+uintmax_t TrimDirectoryLru(const std::filesystem::path& dir,
+    uintmax_t max_size) {
+  int lock_fd = open((dir / kLockFileName).c_str(),
+      O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (lock_fd < 0) {
+    throw std::runtime_error("failed to open lock file in " + dir.string());
+  }
+  if (flock(lock_fd, LOCK_EX) < 0) {
+    close(lock_fd);
+    throw std::runtime_error("failed to lock " + dir.string());
+  }
+
+  struct Entry {
+    std::filesystem::path path;
+    uintmax_t size;
+    struct timespec atime;
+  };
+  std::vector<Entry> entries;
+  uintmax_t total_size = 0;
+  std::error_code ec;
+  std::filesystem::directory_iterator dir_it(dir, ec);
+  if (ec) {
+    close(lock_fd);
+    throw std::runtime_error("failed to list " + dir.string() + ": "
+        + ec.message());
+  }
+  for (const auto& dir_entry : dir_it) {
+    struct stat st;
+    std::string name = dir_entry.path().filename().string();
+    if (name.empty() || name[0] == '.'
+        || stat(dir_entry.path().c_str(), &st) < 0
+        || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    entries.push_back({dir_entry.path(), static_cast<uintmax_t>(st.st_size),
+        st.st_atim});
+    total_size += st.st_size;
+  }
+  if (total_size > max_size) {
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+      return std::make_pair(a.atime.tv_sec, a.atime.tv_nsec)
+          < std::make_pair(b.atime.tv_sec, b.atime.tv_nsec);
+    });
+    for (const auto& entry : entries) {
+      if (total_size <= max_size) {
+        break;
+      }
+      if (std::filesystem::remove(entry.path, ec)) {
+        total_size -= entry.size;
+      }
+    }
+  }
+
+  flock(lock_fd, LOCK_UN);
+  close(lock_fd);
+  return total_size;
+}
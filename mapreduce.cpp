@@ -1,15 +1,220 @@
+#include <dlfcn.h>
 #include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <thread>
 #include <queue>
+#include "include/fingerprint.h"
+#include "include/journal.h"
+#include "include/memory_budget.h"
 #include "include/process.h"
+#include "include/run_cache.h"
+#include "include/socket.h"
 #include "include/tmpdir.h"
 #include "include/key_value.h"
 #include "include/thread_pool.h"
+#include "include/value_order.h"
+#include "include/worker.h"
+
+struct JobOptions {
+  std::string exec = "";
+  size_t block_size = 64 << 20;
+  size_t process_count = std::thread::hardware_concurrency();
+  // persistent cache of map outputs and sorted runs, if any
+  std::optional<std::filesystem::path> cache_dir = std::nullopt;
+  uintmax_t cache_size = uintmax_t(1) << 30;
+  // directory keeping the job state across failures, if any
+  std::optional<std::filesystem::path> resume_dir = std::nullopt;
+  // worker daemons to run tasks on instead of local processes
+  std::vector<std::string> workers = {};
+  // limits applied to every worker process
+  ResourceLimits limits = {};
+  // memory shared by all concurrently running workers, if limited
+  std::optional<size_t> memory_budget = std::nullopt;
+  // order values within each key group for reducers
+  bool sort_values = false;
+  // shared library defining the value order instead of byte order
+  std::optional<std::filesystem::path> value_order_plugin = std::nullopt;
+};
+
+// Memory a task with no explicit limit is assumed to need,
+// relative to its input size.
+const size_t kTaskMemoryPerInputByte = 4;
+const size_t kMinTaskMemory = 16 << 20;
+
+// Worker daemons available to a job. A worker that failed to run a task
+// is not given any more tasks.
+class WorkerSet {
+ public:
+  explicit WorkerSet(const std::vector<std::string>& addresses) :
+      addresses_(addresses), failed_(addresses.size(), false), mutex_() {}
+
+  // Picks a live worker for a task whose input has `input_fingerprint`.
+  // Rendezvous hashing sends the same input to the same worker in every
+  // job, where it is likely kept already, spreads different inputs evenly,
+  // and only moves the tasks of a failed worker elsewhere.
+  std::optional<std::string> Pick(const std::string& input_fingerprint) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::optional<std::string> best_address;
+    std::string best_score;
+    for (size_t i = 0; i < addresses_.size(); i++) {
+      if (failed_[i]) {
+        continue;
+      }
+      // fixed width hex, so strings compare like numbers
+      std::string score = Fingerprint().Update(input_fingerprint)
+          .Update(addresses_[i]).ToString();
+      if (!best_address.has_value() || score > best_score) {
+        best_address = addresses_[i];
+        best_score = score;
+      }
+    }
+    return best_address;
+  }
+
+  void MarkFailed(const std::string& address) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find(addresses_.begin(), addresses_.end(), address);
+    failed_[it - addresses_.begin()] = true;
+  }
+
+ private:
+  std::vector<std::string> addresses_;
+  std::vector<bool> failed_;
+  std::mutex mutex_;
+};
+
+// Working directory of a job. It is either a temporary directory or
+// the one given with --resume, which is only removed once the job succeeds.
+// An existing --resume directory is only accepted if it holds a journal,
+// so that a directory of unrelated files is never taken over.
+class JobDir {
+ public:
+  explicit JobDir(const std::optional<std::filesystem::path>& resume_dir) :
+      tmpdir_(), path_(), entries_() {
+    if (resume_dir.has_value()) {
+      path_ = *resume_dir;
+      if (std::filesystem::exists(path_)
+          && !std::filesystem::exists(path_ / kJournalName)) {
+        throw std::runtime_error(path_.string()
+            + " exists and is not a job directory");
+      }
+      std::filesystem::create_directories(path_);
+    } else {
+      path_ = tmpdir_.emplace("mr_tmp").GetPath();
+    }
+  }
+
+  std::filesystem::path GetPath() const {
+    return path_;
+  }
+
+  bool IsPersistent() const {
+    return !tmpdir_.has_value();
+  }
+
+  // Returns the path of job file `name`, to be removed by Finish().
+  std::filesystem::path GetFile(const std::string& name) {
+    entries_.push_back(name);
+    return path_ / name;
+  }
+
+  // Creates a subdirectory for a job stage, keeping existing contents.
+  std::filesystem::path MakeSubdir(const std::string& name) {
+    std::filesystem::create_directories(path_ / name);
+    return GetFile(name);
+  }
+
+  // Removes everything the job created.
+  void Finish() {
+    if (IsPersistent()) {
+      for (const auto& name : entries_) {
+        std::filesystem::remove_all(path_ / name);
+      }
+      std::filesystem::remove(path_ / kJournalName);
+      // files put there by someone else stay
+      std::error_code ec;
+      std::filesystem::remove(path_, ec);
+    }
+  }
+
+  static constexpr char kJournalName[] = "journal";
+
+ private:
+  std::optional<TmpDir> tmpdir_;
+  std::filesystem::path path_;
+  std::vector<std::string> entries_;
+};
+
+// Flushes `count` chunks in `dir` and the directory itself if `journal`
+// needs them on disk.
+void SyncChunks(const Journal& journal,
+    const std::filesystem::path& dir,
+    size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    journal.SyncOutput(dir / std::to_string(i));
+  }
+  journal.SyncOutput(dir);
+}
+
+// Order of records in the sorted reduce input: by key and, if requested,
+// by value within each key.
+class RecordOrder {
+ public:
+  RecordOrder(bool sort_values, ValueComparator compare_values,
+      const std::string& name) :
+      sort_values_(sort_values), compare_values_(compare_values),
+      name_(name) {}
+
+  bool Less(const KeyValue& a, const KeyValue& b) const {
+    int key_order = a.key.compare(b.key);
+    if (key_order != 0 || !sort_values_) {
+      return key_order < 0;
+    }
+    if (compare_values_ == nullptr) {
+      return a.value < b.value;
+    }
+    return compare_values_(a.value.data(), a.value.size(),
+        b.value.data(), b.value.size()) < 0;
+  }
+
+  // Distinguishes sorted runs of different orders in the run cache.
+  const std::string& GetName() const {
+    return name_;
+  }
+
+ private:
+  bool sort_values_;
+  ValueComparator compare_values_;
+  std::string name_;
+};
+
+// Creates the order requested in `options`, loading the value order
+// plugin if there is one. The plugin stays loaded until exit.
+RecordOrder LoadRecordOrder(const JobOptions& options) {
+  if (!options.value_order_plugin.has_value()) {
+    return RecordOrder(options.sort_values, nullptr,
+        options.sort_values ? "values" : "");
+  }
+  const auto& plugin = *options.value_order_plugin;
+  void* handle = dlopen(plugin.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr) {
+    throw std::runtime_error(std::string("failed to load value order: ")
+        + dlerror());
+  }
+  auto compare_values = reinterpret_cast<ValueComparator>(
+      dlsym(handle, kValueComparatorSymbol));
+  if (compare_values == nullptr) {
+    throw std::runtime_error(plugin.string() + " does not define "
+        + kValueComparatorSymbol);
+  }
+  return RecordOrder(true, compare_values,
+      "plugin " + Fingerprint().UpdateFile(plugin).ToString());
+}
 
 struct ExtSortElement {
   size_t chunk_number;
@@ -18,9 +223,6 @@ struct ExtSortElement {
   ExtSortElement(size_t chunk_number, TsvKeyValue data) :
       chunk_number(chunk_number),
       data(data) {}
-  bool operator<(const ExtSortElement& oth) const {
-    return data.key > oth.data.key;
-  }
 };
 
 // Reads `infile` and splits it into `outdir` with size limit of `size`
@@ -66,44 +268,90 @@ size_t SplitBySize(
   return chunk_count;
 }
 
-// Reads `infile` and performs an external sort of its contents.
+// Reads `infile` and performs an external sort of its contents in `order`.
 // Writes results to `outfile`.
 // Splits data into chunks of `chunk_size_limit` in process and sorts them,
 // creates temporary entries in the `workdir` for that purpose.
+// Sorted chunks are taken from and saved to `cache` if it is present.
+// Completed steps are recorded in `journal` and skipped on resume.
 void ExternalSortByKey(
     const std::filesystem::path& infile,
     const std::filesystem::path& outfile,
-    const std::filesystem::path& workdir,
-    size_t chunk_size_limit) {
-  TmpDir chunks_dir(workdir / "sorted_chunks");
+    JobDir& workdir,
+    size_t chunk_size_limit,
+    const RecordOrder& order,
+    const std::optional<RunCache>& cache,
+    Journal& journal) {
+  auto chunks_dir = workdir.MakeSubdir("sorted_chunks");
   TsvKeyValue kv;
 
   // step 1: split
-  size_t chunk_count = SplitBySize(infile, chunks_dir.GetPath(),
-      chunk_size_limit);
+  size_t chunk_count;
+  if (auto result = journal.Find("sort_split")) {
+    chunk_count = std::stoul(*result);
+  } else {
+    chunk_count = SplitBySize(infile, chunks_dir, chunk_size_limit);
+    SyncChunks(journal, chunks_dir, chunk_count);
+    journal.Record("sort_split", std::to_string(chunk_count));
+  }
   for (size_t chunk_num = 0; chunk_num < chunk_count; ++chunk_num) {
+    std::string step = "sorted_run " + std::to_string(chunk_num);
+    if (journal.IsDone(step)) {
+      continue;
+    }
     std::vector<TsvKeyValue> entries;
-    auto chunk_path = chunks_dir.GetPath() / std::to_string(chunk_num);
+    auto chunk_path = chunks_dir / std::to_string(chunk_num);
+    std::string cache_key;
+    if (cache.has_value()) {
+      cache_key = Fingerprint().Update("sorted_run")
+          .Update(order.GetName())
+          .UpdateFile(chunk_path).ToString();
+      if (cache->Restore(cache_key, chunk_path)) {
+        journal.SyncOutput(chunk_path);
+        journal.SyncOutput(chunks_dir);
+        journal.Record(step);
+        continue;
+      }
+    }
     std::ifstream fin(chunk_path);
     while (fin >> kv) {
       entries.push_back(std::move(kv));
     }
     fin.close();
-    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
-      return a.key < b.key;
-    });
-    std::ofstream fout(chunk_path);
+    std::sort(entries.begin(), entries.end(),
+        [&](const auto& a, const auto& b) {
+          return order.Less(a, b);
+        });
+    // the unsorted chunk must survive until its sorted version is complete
+    auto sorted_path = chunks_dir / (std::to_string(chunk_num) + ".sorted");
+    std::ofstream fout(sorted_path);
     for (const auto& entry : entries) {
       fout << entry << std::endl;
     }
     fout.close();
+    std::filesystem::rename(sorted_path, chunk_path);
+    if (cache.has_value()) {
+      cache->Store(cache_key, chunk_path);
+    }
+    journal.SyncOutput(chunk_path);
+    journal.SyncOutput(chunks_dir);
+    journal.Record(step);
   }
 
   // step 2: merge
   std::vector<std::ifstream> chunk_files;
-  std::priority_queue<ExtSortElement> heap;
+  auto heap_order = [&](const ExtSortElement& a, const ExtSortElement& b) {
+    return order.Less(b.data, a.data);
+  };
+  std::priority_queue<ExtSortElement, std::vector<ExtSortElement>,
+      decltype(heap_order)> heap(heap_order);
   for (size_t chunk_num = 0; chunk_num < chunk_count; ++chunk_num) {
-    chunk_files.emplace_back(chunks_dir.GetPath() / std::to_string(chunk_num));
+    chunk_files.emplace_back(chunks_dir / std::to_string(chunk_num));
+    if (!chunk_files.back().is_open()) {
+      std::ostringstream err;
+      err << "failed to open sorted run " << chunk_num << " for merging";
+      throw std::runtime_error(err.str());
+    }
     if (chunk_files.back() >> kv) {
       heap.emplace(chunk_num, std::move(kv));
     }
@@ -155,30 +403,116 @@ size_t SplitByKey(
   return chunk_count;
 }
 
-// Runs `exec` processes for all `count` chunks from `indir`.
+// Runs `exec` for chunk `chunk_num` and returns its exit code.
+// If there are worker daemons, the task is moved to the next live worker
+// whenever the connection to the current one fails. Errors a worker
+// reports (e.g. a rejected executable) fail the task like local ones.
+int RunTask(
+    const std::string& exec,
+    const std::filesystem::path& input,
+    const std::filesystem::path& output,
+    const ResourceLimits& limits,
+    size_t chunk_num,
+    WorkerSet* workers) {
+  if (workers == nullptr) {
+    auto process = Process::Create(exec);
+    process->SetLimits(limits);
+    process->Run(input, output);
+    return process->Wait();
+  }
+  auto input_fingerprint = Fingerprint().UpdateFile(input).ToString();
+  while (auto address = workers->Pick(input_fingerprint)) {
+    try {
+      auto process = Process::CreateRemote(*address, exec, input_fingerprint);
+      process->SetLimits(limits);
+      process->Run(input, output);
+      return process->Wait();
+    } catch (const ConnectionError& e) {
+      std::cerr << "rescheduling chunk " << chunk_num << ": " << e.what()
+          << std::endl;
+      workers->MarkFailed(*address);
+    }
+  }
+  throw std::runtime_error("no live workers left");
+}
+
+// Runs `options.exec` processes for the given `chunks` from `indir`.
 // Writes corresponding chunks to `outdir`.
-// Runs at most `process_count` worker processes at a time.
+// Runs at most `options.process_count` worker processes at a time,
+// and only as many as fit into `options.memory_budget`. Remote tasks
+// don't take from the budget, they use memory of the workers' machines.
+// Chunks are journaled as `step` followed by chunk number, chunks that
+// are already in `journal` are skipped.
 void RunForAllChunks(
-    const std::string& exec,
+    const JobOptions& options,
     const std::filesystem::path& indir,
     const std::filesystem::path& outdir,
-    size_t count,
-    size_t process_count) {
-  ThreadPool pool(process_count);
+    const std::vector<size_t>& chunks,
+    Journal& journal,
+    const std::string& step) {
+  ThreadPool pool(options.process_count);
+  std::optional<WorkerSet> workers;
+  if (!options.workers.empty()) {
+    workers.emplace(options.workers);
+  }
+  std::optional<MemoryBudget> budget;
+  if (options.memory_budget.has_value() && !workers.has_value()) {
+    budget.emplace(*options.memory_budget);
+  }
   bool all_exited_normally = true;
+  std::string error;
   std::mutex mutex;
-  for (size_t i = 0; i < count; i++) {
-    pool.Run([&, i]() {
-      auto process = Process::Create(exec);
-      process->Run(
-          indir / std::to_string(i),
-          outdir / std::to_string(i));
-      auto retcode = process->Wait();
-      std::lock_guard<std::mutex> lock(mutex);
-      all_exited_normally &= retcode == 0;
-    });
+  try {
+    for (size_t i : chunks) {
+      std::string chunk_step = step + ' ' + std::to_string(i);
+      if (journal.IsDone(chunk_step)) {
+        continue;
+      }
+      const auto& limits = options.limits;
+      // tasks are admitted in order, so a large one is not starved
+      // by smaller ones behind it
+      size_t reserved = 0;
+      if (budget.has_value()) {
+        reserved = budget->Acquire(limits.memory.value_or(std::max(
+            kMinTaskMemory,
+            kTaskMemoryPerInputByte
+                * std::filesystem::file_size(indir / std::to_string(i)))));
+      }
+      pool.Run([&, i, chunk_step, reserved]() {
+        int retcode;
+        try {
+          retcode = RunTask(options.exec,
+              indir / std::to_string(i),
+              outdir / std::to_string(i),
+              limits,
+              i,
+              workers.has_value() ? &*workers : nullptr);
+          if (retcode == 0) {
+            journal.SyncOutput(outdir / std::to_string(i));
+            journal.SyncOutput(outdir);
+            journal.Record(chunk_step);
+          }
+        } catch (const std::exception& e) {
+          retcode = -1;
+          std::lock_guard<std::mutex> lock(mutex);
+          error = e.what();
+        }
+        if (budget.has_value()) {
+          budget->Release(reserved);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        all_exited_normally &= retcode == 0;
+      });
+    }
+  } catch (...) {
+    // running tasks refer to this frame
+    pool.WaitForAll();
+    throw;
   }
   pool.WaitForAll();
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
   if (!all_exited_normally) {
     throw std::runtime_error("one of workers did not exit normally");
   }
@@ -201,62 +535,200 @@ void MergeChunks(
   fout.close();
 }
 
+// Fingerprints the executable that `exec` refers to, falling back to
+// the name itself for executables looked up in PATH.
+Fingerprint ExecFingerprint(const std::string& exec) {
+  Fingerprint fingerprint;
+  fingerprint.Update(exec);
+  if (std::filesystem::is_regular_file(exec)) {
+    fingerprint.UpdateFile(exec);
+  }
+  return fingerprint;
+}
+
+std::vector<size_t> AllChunks(size_t count) {
+  std::vector<size_t> chunks(count);
+  for (size_t i = 0; i < count; i++) {
+    chunks[i] = i;
+  }
+  return chunks;
+}
+
+// Opens the journal of the job in `workdir` and makes sure that
+// a resumed job is the same one that was started there.
+std::unique_ptr<Journal> OpenJournal(const JobDir& workdir,
+    const std::string& job) {
+  auto journal = std::make_unique<Journal>(
+      workdir.GetPath() / JobDir::kJournalName, workdir.IsPersistent());
+  if (auto recorded_job = journal->Find("job")) {
+    if (*recorded_job != job) {
+      throw std::runtime_error("job directory " + workdir.GetPath().string()
+          + " belongs to another job: " + *recorded_job);
+    }
+  } else {
+    journal->SyncOutput(workdir.GetPath());
+    journal->Record("job", job);
+  }
+  return journal;
+}
+
 void DoMap(const std::filesystem::path& infile,
     const std::filesystem::path& outfile,
-    const std::string& exec,
-    size_t block_size,
-    size_t process_count) {
-  TmpDir workdir("mr_tmp");
-  TmpDir input_chunks(workdir.GetPath() / "input_chunks");
-  size_t key_count = SplitBySize(infile, input_chunks.GetPath(),
-      block_size);
-  TmpDir output_chunks(workdir.GetPath() / "output_chunks");
-  RunForAllChunks(exec,
-      input_chunks.GetPath(),
-      output_chunks.GetPath(),
-      key_count,
-      process_count);
-  MergeChunks(output_chunks.GetPath(), outfile, key_count);
+    const JobOptions& options) {
+  JobDir workdir(options.resume_dir);
+  auto journal = OpenJournal(workdir,
+      "map " + options.exec + ' ' + infile.string());
+  auto input_chunks = workdir.MakeSubdir("input_chunks");
+  size_t key_count;
+  if (auto result = journal->Find("split")) {
+    key_count = std::stoul(*result);
+  } else {
+    key_count = SplitBySize(infile, input_chunks, options.block_size);
+    SyncChunks(*journal, input_chunks, key_count);
+    journal->Record("split", std::to_string(key_count));
+  }
+  auto output_chunks = workdir.MakeSubdir("output_chunks");
+  if (!options.cache_dir.has_value()) {
+    RunForAllChunks(options,
+        input_chunks,
+        output_chunks,
+        AllChunks(key_count),
+        *journal,
+        "map");
+  } else {
+    // splits are cut from the beginning of the input, so appending to it
+    // leaves all splits but the last ones unchanged
+    RunCache cache(*options.cache_dir, options.cache_size);
+    auto exec_fingerprint = ExecFingerprint(options.exec).Update("map");
+    std::vector<std::string> cache_keys(key_count);
+    std::vector<size_t> changed_chunks;
+    for (size_t i = 0; i < key_count; i++) {
+      cache_keys[i] = Fingerprint(exec_fingerprint)
+          .UpdateFile(input_chunks / std::to_string(i))
+          .ToString();
+      if (!cache.Restore(cache_keys[i],
+          output_chunks / std::to_string(i))) {
+        changed_chunks.push_back(i);
+      }
+    }
+    RunForAllChunks(options,
+        input_chunks,
+        output_chunks,
+        changed_chunks,
+        *journal,
+        "map");
+    for (size_t i : changed_chunks) {
+      cache.Store(cache_keys[i], output_chunks / std::to_string(i));
+    }
+    cache.Trim();
+  }
+  MergeChunks(output_chunks, outfile, key_count);
+  journal.reset();
+  workdir.Finish();
 }
 
 void DoReduce(const std::filesystem::path& infile,
     const std::filesystem::path& outfile,
-    const std::string& exec,
-    size_t block_size,
-    size_t process_count) {
-  TmpDir workdir("mr_tmp");
-  auto sorted_infile = workdir.GetPath() / "sorted_infile";
-  ExternalSortByKey(infile, sorted_infile, workdir.GetPath(), block_size);
-  TmpDir input_chunks(workdir.GetPath() / "input_chunks");
-  size_t key_count = SplitByKey(sorted_infile, input_chunks.GetPath());
-  TmpDir output_chunks(workdir.GetPath() / "output_chunks");
-  RunForAllChunks(exec,
-      input_chunks.GetPath(),
-      output_chunks.GetPath(),
-      key_count,
-      process_count);
-  MergeChunks(output_chunks.GetPath(), outfile, key_count);
+    const JobOptions& options) {
+  auto order = LoadRecordOrder(options);
+  JobDir workdir(options.resume_dir);
+  // runs of a half-done sort may only be merged with runs of the same order
+  auto journal = OpenJournal(workdir,
+      "reduce " + options.exec + ' ' + infile.string()
+          + " order=" + order.GetName());
+  std::optional<RunCache> cache;
+  if (options.cache_dir.has_value()) {
+    cache.emplace(*options.cache_dir, options.cache_size);
+  }
+  auto sorted_infile = workdir.GetFile("sorted_infile");
+  auto sorted_chunks = workdir.GetFile("sorted_chunks");
+  if (!journal->IsDone("sort")) {
+    ExternalSortByKey(infile, sorted_infile, workdir,
+        options.block_size, order, cache, *journal);
+    if (cache.has_value()) {
+      cache->Trim();
+    }
+    journal->SyncOutput(sorted_infile);
+    journal->SyncOutput(workdir.GetPath());
+    journal->Record("sort");
+  }
+  // sorted runs are only dropped once the merged file is journaled
+  std::filesystem::remove_all(sorted_chunks);
+  auto input_chunks = workdir.MakeSubdir("input_chunks");
+  size_t key_count;
+  if (auto result = journal->Find("split")) {
+    key_count = std::stoul(*result);
+  } else {
+    key_count = SplitByKey(sorted_infile, input_chunks);
+    SyncChunks(*journal, input_chunks, key_count);
+    journal->Record("split", std::to_string(key_count));
+  }
+  auto output_chunks = workdir.MakeSubdir("output_chunks");
+  RunForAllChunks(options,
+      input_chunks,
+      output_chunks,
+      AllChunks(key_count),
+      *journal,
+      "reduce");
+  MergeChunks(output_chunks, outfile, key_count);
+  journal.reset();
+  workdir.Finish();
 }
 
 void PrintUsageAndExit(const char* program_name) {
   std::cerr << "Usage: " << program_name
       << " <map|reduce> <exec> <input> <output>"
-      << " [-p COUNT] [-s SIZE]" << std::endl
+      << " [-p COUNT] [-s SIZE] [-c DIR] [--resume DIR] [-w ADDRESS]..."
+      << " [-m SIZE] [-l SIZE] [-t SECONDS] [--cgroup DIR] [--pin]"
+      << " [--sort-values] [--value-order LIB]" << std::endl
+      << "       " << program_name << " worker <address> <exec>..."
+      << std::endl
       << "  -p COUNT   use at most COUNT parallel processes" << std::endl
-      << "  -s SIZE    split input into blocks of SIZE bytes" << std::endl;
+      << "  -s SIZE    split input into blocks of SIZE bytes" << std::endl
+      << "  -c DIR     reuse map outputs and sorted runs cached in DIR"
+      << std::endl
+      << "  --cache-size SIZE  keep at most SIZE bytes in the -c cache,"
+      << " 1 GiB by default" << std::endl
+      << "  --resume DIR  keep job state in DIR, continue the job"
+      << " from there if it was interrupted" << std::endl
+      << "  -w ADDRESS  run tasks on the worker listening on ADDRESS"
+      << " (socket path or HOST:PORT), may be repeated" << std::endl
+      << "  worker mode runs the listed executables for anyone who can"
+      << " connect to <address>; a TCP address without HOST listens"
+      << " on loopback only" << std::endl
+      << "  -m SIZE    run only as many workers as fit into SIZE bytes"
+      << " of memory, ignored for tasks run with -w" << std::endl
+      << "  -l SIZE    limit address space of each worker to SIZE bytes"
+      << std::endl
+      << "  -t SECONDS limit CPU time of each worker" << std::endl
+      << "  --cgroup DIR  run each worker in a child of cgroup v2 DIR"
+      << " with memory.max set to the -l limit" << std::endl
+      << "  --pin      pin workers to CPUs" << std::endl
+      << "  --sort-values  pass values of each key to reducers in order,"
+      << " reduce only" << std::endl
+      << "  --value-order LIB  order values with mr_compare_values()"
+      << " from shared library LIB, implies --sort-values" << std::endl;
   exit(1);
 }
 
 int main(int argc, char** argv) {
+  if (argc >= 4 && !strcmp(argv[1], "worker")) {
+    try {
+      RunWorker(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+    } catch (const std::exception& e) {
+      std::cerr << "worker failed" << std::endl << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
   if (argc < 5) {
     PrintUsageAndExit(argv[0]);
   }
   std::string mr_mode(argv[1]);
-  std::string mr_exec(argv[2]);
+  JobOptions options;
+  options.exec = argv[2];
   std::filesystem::path infile(argv[3]);
   std::filesystem::path outfile(argv[4]);
-  size_t process_count = std::thread::hardware_concurrency();
-  size_t block_size = 64 << 20;
   for (int i = 5; i < argc; i++) {
     if (!strcmp(argv[i], "-p")) {
       ++i;
@@ -264,7 +736,7 @@ int main(int argc, char** argv) {
         PrintUsageAndExit(argv[0]);
       }
       char* err;
-      process_count = strtoul(argv[i], &err, 0);
+      options.process_count = strtoul(argv[i], &err, 0);
       if (*err) {
         PrintUsageAndExit(argv[0]);
       }
@@ -274,19 +746,88 @@ int main(int argc, char** argv) {
         PrintUsageAndExit(argv[0]);
       }
       char* err;
-      block_size = strtoul(argv[i], &err, 0);
+      options.block_size = strtoul(argv[i], &err, 0);
+      if (*err) {
+        PrintUsageAndExit(argv[0]);
+      }
+    } else if (!strcmp(argv[i], "-c")) {
+      ++i;
+      if (i == argc) {
+        PrintUsageAndExit(argv[0]);
+      }
+      options.cache_dir = argv[i];
+    } else if (!strcmp(argv[i], "--cache-size")) {
+      ++i;
+      if (i == argc) {
+        PrintUsageAndExit(argv[0]);
+      }
+      char* err;
+      options.cache_size = strtoull(argv[i], &err, 0);
       if (*err) {
         PrintUsageAndExit(argv[0]);
       }
+    } else if (!strcmp(argv[i], "--resume")) {
+      ++i;
+      if (i == argc) {
+        PrintUsageAndExit(argv[0]);
+      }
+      options.resume_dir = argv[i];
+    } else if (!strcmp(argv[i], "-w")) {
+      ++i;
+      if (i == argc) {
+        PrintUsageAndExit(argv[0]);
+      }
+      options.workers.push_back(argv[i]);
+    } else if (!strcmp(argv[i], "-m")
+        || !strcmp(argv[i], "-l")
+        || !strcmp(argv[i], "-t")) {
+      const char* option = argv[i];
+      ++i;
+      if (i == argc) {
+        PrintUsageAndExit(argv[0]);
+      }
+      char* err;
+      size_t value = strtoul(argv[i], &err, 0);
+      if (*err) {
+        PrintUsageAndExit(argv[0]);
+      }
+      if (!strcmp(option, "-m")) {
+        options.memory_budget = value;
+      } else if (!strcmp(option, "-l")) {
+        options.limits.memory = value;
+      } else {
+        options.limits.cpu_time = value;
+      }
+    } else if (!strcmp(argv[i], "--cgroup")) {
+      ++i;
+      if (i == argc) {
+        PrintUsageAndExit(argv[0]);
+      }
+      options.limits.cgroup = argv[i];
+    } else if (!strcmp(argv[i], "--pin")) {
+      options.limits.pin_cpu = true;
+    } else if (!strcmp(argv[i], "--sort-values")) {
+      options.sort_values = true;
+    } else if (!strcmp(argv[i], "--value-order")) {
+      ++i;
+      if (i == argc) {
+        PrintUsageAndExit(argv[0]);
+      }
+      options.sort_values = true;
+      options.value_order_plugin = argv[i];
     } else {
       PrintUsageAndExit(argv[0]);
     }
   }
+  // values are only ever ordered for reducers
+  if (mr_mode == "map" && options.sort_values) {
+    PrintUsageAndExit(argv[0]);
+  }
   try {
     if (mr_mode == "map") {
-      DoMap(infile, outfile, mr_exec, block_size, process_count);
+      DoMap(infile, outfile, options);
     } else if (mr_mode == "reduce") {
-      DoReduce(infile, outfile, mr_exec, block_size, process_count);
+      DoReduce(infile, outfile, options);
     } else {
       throw std::runtime_error("unknown mode: " + mr_mode);
     }
@@ -0,0 +1,23 @@
+#include <algorithm>
+#include "include/memory_budget.h"
+
+MemoryBudget::MemoryBudget(size_t total) :
+    total_(total), available_(total), mutex_(), cv_() {}
+
+size_t MemoryBudget::Acquire(size_t amount) {
+  amount = std::min(amount, total_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this, amount]() {
+    return available_ >= amount;
+  });
+  available_ -= amount;
+  return amount;
+}
+
+void MemoryBudget::Release(size_t amount) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    available_ += amount;
+  }
+  cv_.notify_all();
+}
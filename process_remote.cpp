@@ -0,0 +1,125 @@
+#include <optional>
+#include "include/fingerprint.h"
+#include "include/process.h"
+#include "include/socket.h"
+
+namespace {
+
+template <class T>
+std::string OptionalToString(const std::optional<T>& value) {
+  return value.has_value() ? std::to_string(*value) : "";
+}
+
+}  // namespace
+
+class ProcessRemote : public Process {
+ public:
+  ProcessRemote(const std::string& address, const std::string& exec,
+      const std::optional<std::string>& input_fingerprint) :
+      address_(address), exec_(exec), args_(), input_(),
+      input_fingerprint_(input_fingerprint), output_(), limits_(), socket_(),
+      state_(ProcessState::CREATED) {}
+
+  void Run() override {
+    if (state_ != ProcessState::CREATED) {
+      throw std::runtime_error("can't run twice");
+    }
+    for (const auto& arg : args_) {
+      if (arg.size() > Socket::kMaxControlFrameSize) {
+        throw std::runtime_error("argument is too long for a remote task");
+      }
+    }
+    socket_.emplace(Socket::Connect(address_));
+    socket_->WriteFrame("run");
+    socket_->WriteFrame(exec_);
+    socket_->WriteFrame(std::to_string(args_.size()));
+    for (const auto& arg : args_) {
+      socket_->WriteFrame(arg);
+    }
+    // cgroups belong to the local machine and are not forwarded
+    socket_->WriteFrame(OptionalToString(limits_.memory));
+    socket_->WriteFrame(OptionalToString(limits_.cpu_time));
+    // the worker picks a CPU of its own machine
+    socket_->WriteFrame(limits_.pin_cpu ? "1" : "0");
+    socket_->WriteFrame(output_.has_value() ? "1" : "0");
+    if (input_.has_value() && !input_fingerprint_.has_value()) {
+      input_fingerprint_ = Fingerprint().UpdateFile(*input_).ToString();
+    }
+    socket_->WriteFrame(input_.has_value() ? *input_fingerprint_ : "");
+    // the worker accepts or rejects the task before the input is sent,
+    // and only asks for an input it doesn't have yet
+    std::string status = ReadStatus();
+    if (status == "send" && input_.has_value()) {
+      socket_->SendFile(*input_);
+    } else if (status != "ready") {
+      throw ConnectionError("unexpected reply from worker " + address_);
+    }
+    state_ = ProcessState::RUNNING;
+  }
+  void SetArguments(const std::vector<std::string>& args) override {
+    if (state_ != ProcessState::CREATED) {
+      throw std::runtime_error("can't change args after start");
+    }
+    args_ = args;
+  }
+  void SetInput(const std::filesystem::path& path) override {
+    if (state_ != ProcessState::CREATED) {
+      throw std::runtime_error("can't change input after start");
+    }
+    input_ = path;
+  }
+  void SetOutput(const std::filesystem::path& path) override {
+    if (state_ != ProcessState::CREATED) {
+      throw std::runtime_error("can't change output after start");
+    }
+    output_ = path;
+  }
+  void SetLimits(const ResourceLimits& limits) override {
+    if (state_ != ProcessState::CREATED) {
+      throw std::runtime_error("can't change limits after start");
+    }
+    limits_ = limits;
+  }
+  int Wait() override {
+    if (state_ != ProcessState::RUNNING) {
+      throw std::runtime_error("process isn't running");
+    }
+    state_ = ProcessState::TERMINATED;
+    if (ReadStatus() != "exit") {
+      throw ConnectionError("unexpected reply from worker " + address_);
+    }
+    int retcode = std::stoi(socket_->ReadFrame());
+    if (output_.has_value()) {
+      socket_->ReceiveFile(*output_);
+    }
+    socket_.reset();
+    return retcode;
+  }
+
+ private:
+  // Reads a reply, throwing the error if the worker reports one.
+  std::string ReadStatus() {
+    std::string status = socket_->ReadFrame();
+    if (status == "error") {
+      throw std::runtime_error("worker " + address_ + " failed: "
+          + socket_->ReadFrame());
+    }
+    return status;
+  }
+
+  std::string address_;
+  std::string exec_;
+  std::vector<std::string> args_;
+  std::optional<std::filesystem::path> input_;
+  std::optional<std::string> input_fingerprint_;
+  std::optional<std::filesystem::path> output_;
+  ResourceLimits limits_;
+  std::optional<Socket> socket_;
+  ProcessState state_;
+};
+
+std::unique_ptr<Process> Process::CreateRemote(const std::string& address,
+    const std::filesystem::path& path,
+    const std::optional<std::string>& input_fingerprint) {
+  return std::make_unique<ProcessRemote>(address, path, input_fingerprint);
+}
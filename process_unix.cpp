@@ -1,100 +1,271 @@
 #include <unistd.h>
 #include <fcntl.h>
+#include <sched.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
 #include <vector>
 #include <optional>
 #include "include/process.h"
 
-enum class ProcessState {
-  CREATED,
-  RUNNING,
-  TERMINATED,
+extern char** environ;
+
+namespace {
+
+std::atomic<size_t> cgroup_count = 0;
+
+// Hands out CPUs from the affinity mask of this process (as restricted by
+// cpusets or taskset) to processes being started, the least busy first.
+class CpuAllocator {
+ public:
+  CpuAllocator() : mutex_(), cpus_(), running_() {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+      throw std::runtime_error("sched_getaffinity() failed");
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        cpus_.push_back(cpu);
+      }
+    }
+    running_.assign(cpus_.size(), 0);
+  }
+
+  int Acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t index = std::min_element(running_.begin(), running_.end())
+        - running_.begin();
+    ++running_[index];
+    return cpus_[index];
+  }
+
+  void Release(int cpu) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t index = std::find(cpus_.begin(), cpus_.end(), cpu) - cpus_.begin();
+    --running_[index];
+  }
+
+  static CpuAllocator& Get() {
+    static CpuAllocator allocator;
+    return allocator;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<int> cpus_;
+  std::vector<size_t> running_;
 };
 
+// Stack of the child between clone() and execve(), only needs to fit
+// ChildMain() and the syscall wrappers it calls.
+constexpr size_t kChildStackSize = 64 << 10;
+
+// Everything the child needs, prepared by the parent beforehand.
+// The child shares memory with the parent and runs on a separate stack
+// until execve(), so it may only make async-signal-safe calls: no
+// allocations, no locks, no exceptions.
+struct SpawnArgs {
+  const char* path;
+  char* const* argv;
+  int input_fd;
+  int output_fd;
+  int cgroup_procs_fd;
+  std::optional<rlimit> address_space;
+  std::optional<rlimit> cpu_time;
+  std::optional<cpu_set_t> cpus;
+  sigset_t signal_mask;
+  // set by the child if it fails before execve()
+  int error;
+  const char* failed_call;
+};
+
+// Makes `fd` the child's `target_fd` without close-on-exec.
+bool RedirectFd(int fd, int target_fd) {
+  if (fd == target_fd) {
+    return fcntl(fd, F_SETFD, 0) == 0;
+  }
+  return dup2(fd, target_fd) == target_fd;
+}
+
+// Resets signals with handlers to their defaults. The child gets its own
+// copy of the dispositions (no CLONE_SIGHAND), so this does not touch the
+// parent; sigaction() is a thin async-signal-safe rt_sigaction wrapper.
+void ResetSignalHandlers() {
+  for (int sig = 1; sig < NSIG; sig++) {
+    struct sigaction action;
+    // signals reserved by libc fail here and are left alone
+    if (sigaction(sig, nullptr, &action) == 0
+        && action.sa_handler != SIG_DFL
+        && action.sa_handler != SIG_IGN) {
+      action.sa_handler = SIG_DFL;
+      action.sa_flags = 0;
+      sigemptyset(&action.sa_mask);
+      sigaction(sig, &action, nullptr);
+    }
+  }
+}
+
+int ChildMain(void* arg) {
+  auto& args = *static_cast<SpawnArgs*>(arg);
+  args.failed_call = nullptr;
+  // signals stay blocked until the handlers are gone
+  ResetSignalHandlers();
+  if (args.input_fd >= 0 && !RedirectFd(args.input_fd, STDIN_FILENO)) {
+    args.failed_call = "dup2() for stdin";
+  } else if (args.output_fd >= 0
+      && !RedirectFd(args.output_fd, STDOUT_FILENO)) {
+    args.failed_call = "dup2() for stdout";
+  } else if (args.address_space.has_value()
+      && setrlimit(RLIMIT_AS, &*args.address_space) < 0) {
+    args.failed_call = "setrlimit() for address space";
+  } else if (args.cpu_time.has_value()
+      && setrlimit(RLIMIT_CPU, &*args.cpu_time) < 0) {
+    args.failed_call = "setrlimit() for CPU time";
+  } else if (args.cpus.has_value()
+      && sched_setaffinity(0, sizeof(cpu_set_t), &*args.cpus) < 0) {
+    args.failed_call = "sched_setaffinity()";
+  } else if (args.cgroup_procs_fd >= 0
+      && write(args.cgroup_procs_fd, "0", 1) != 1) {
+    // "0" stands for the writing process
+    args.failed_call = "joining cgroup";
+  } else if (sigprocmask(SIG_SETMASK, &args.signal_mask, nullptr) < 0) {
+    args.failed_call = "sigprocmask()";
+  } else {
+    execve(args.path, args.argv, environ);
+    args.failed_call = "execve()";
+  }
+  args.error = errno;
+  _exit(127);
+}
+
+// Looks `exec` up in PATH the way execvp() does.
+std::string ResolveExecutable(const std::string& exec) {
+  if (exec.find('/') != std::string::npos) {
+    return exec;
+  }
+  const char* path_env = getenv("PATH");
+  std::istringstream dirs(path_env != nullptr ? path_env : "/bin:/usr/bin");
+  std::string dir;
+  while (std::getline(dirs, dir, ':')) {
+    auto candidate = (dir.empty() ? "." : dir) + "/" + exec;
+    if (access(candidate.c_str(), X_OK) == 0) {
+      return candidate;
+    }
+  }
+  throw std::runtime_error("\"" + exec + "\" not found in PATH");
+}
+
+int OpenOrThrow(const std::string& path, int flags, const char* purpose) {
+  int fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::ostringstream ss;
+    ss << "opening \"" << path << "\" for " << purpose << " failed: "
+        << strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+  return fd;
+}
+
+rlimit MakeRlimit(size_t value) {
+  return {value, value};
+}
+
+}  // namespace
+
 class ProcessUnix : public Process {
  public:
   explicit ProcessUnix(const std::string& exec) :
-      exec_(exec), args_(), input_(), output_(), pid_(0),
-      state_(ProcessState::CREATED) {}
+      exec_(exec), args_(), input_(), output_(), limits_(), cgroup_(),
+      cpu_(), pid_(0), state_(ProcessState::CREATED) {}
 
+  // Starts the process with clone(CLONE_VM | CLONE_VFORK): the child
+  // borrows the parent's address space instead of copying its page tables,
+  // so the cost of a launch does not grow with the parent's heap, and
+  // the calling thread is suspended until the child calls execve().
   void Run() override {
     if (state_ != ProcessState::CREATED) {
       throw std::runtime_error("can't run twice");
     }
-    int pipefd[2];
-    if (pipe2(pipefd, O_CLOEXEC) < 0) {
-      throw std::runtime_error("pipe2() failed");
+    std::string path = ResolveExecutable(exec_);
+    std::vector<char*> argv;
+    argv.push_back(exec_.data());
+    for (auto& arg : args_) {
+      argv.push_back(arg.data());
     }
-    pid_t res = fork();
-    if (res < 0) {
-      close(pipefd[0]);
-      close(pipefd[1]);
-      throw std::runtime_error("fork() failed");
-    }
-    if (res == 0) {
-      close(pipefd[0]);
-      try {
-        std::vector<char*> argv;
-        argv.push_back(exec_.data());
-        for (auto& arg : args_) {
-          argv.push_back(arg.data());
-        }
-        argv.push_back(nullptr);
-
-        if (input_.has_value()) {
-          int fd = open(input_->c_str(), O_RDONLY);
-          if (fd < 0) {
-            std::ostringstream ss;
-            ss << "opening \"" << *input_ << "\" for read failed";
-            throw std::runtime_error(ss.str());
-          }
-          int ret = dup2(fd, STDIN_FILENO);
-          close(fd);
-          if (ret < 0) {
-            throw std::runtime_error("dup2() for stdin failed");
-          }
-        }
-
-        if (output_.has_value()) {
-          int fd = open(output_->c_str(), O_WRONLY | O_CREAT, 0644);
-          if (fd < 0) {
-            std::ostringstream ss;
-            ss << "opening \"" << *output_ << "\" for write failed";
-            throw std::runtime_error(ss.str());
-          }
-          int ret = dup2(fd, STDOUT_FILENO);
-          close(fd);
-          if (ret < 0) {
-            throw std::runtime_error("dup2() for stdout failed");
-          }
-        }
-
-        execvp(exec_.c_str(), argv.data());
-        throw std::runtime_error("execvp() failed");
-      } catch (const std::exception& e) {
-        write(pipefd[1], e.what(), strlen(e.what()));
-        close(pipefd[1]);
-        _exit(0);
+    argv.push_back(nullptr);
+
+    SpawnArgs spawn_args{};
+    spawn_args.path = path.c_str();
+    spawn_args.argv = argv.data();
+    spawn_args.input_fd = -1;
+    spawn_args.output_fd = -1;
+    spawn_args.cgroup_procs_fd = -1;
+    if (limits_.memory.has_value()) {
+      spawn_args.address_space = MakeRlimit(*limits_.memory);
+    }
+    if (limits_.cpu_time.has_value()) {
+      spawn_args.cpu_time = MakeRlimit(*limits_.cpu_time);
+    }
+    if (limits_.pin_cpu) {
+      cpu_ = CpuAllocator::Get().Acquire();
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(*cpu_, &cpus);
+      spawn_args.cpus = cpus;
+    }
+    std::vector<char> stack(kChildStackSize);
+
+    pid_t res = -1;
+    int clone_errno = 0;
+    try {
+      if (input_.has_value()) {
+        spawn_args.input_fd = OpenOrThrow(*input_, O_RDONLY, "read");
       }
-    } else {
-      pid_ = res;
-      close(pipefd[1]);
-      std::vector<char> buf(256);
-      std::string exc_msg;
-      int cnt;
-      while ((cnt = read(pipefd[0], buf.data(), buf.size())) > 0) {
-        exc_msg.append(buf.begin(), buf.begin() + cnt);
+      if (output_.has_value()) {
+        spawn_args.output_fd = OpenOrThrow(*output_,
+            O_WRONLY | O_CREAT | O_TRUNC, "write");
       }
-      close(pipefd[0]);
-      if (!exc_msg.empty()) {
-        std::ostringstream s;
-        s << "failed to create process: " << exc_msg;
-        throw std::runtime_error(s.str());
+      if (limits_.cgroup.has_value()) {
+        CreateCgroup();
+        spawn_args.cgroup_procs_fd = OpenOrThrow(
+            *cgroup_ / "cgroup.procs", O_WRONLY, "write");
       }
-      state_ = ProcessState::RUNNING;
+      // no signal handler may run on the child's stack in shared memory
+      sigset_t all_signals;
+      sigfillset(&all_signals);
+      pthread_sigmask(SIG_SETMASK, &all_signals, &spawn_args.signal_mask);
+      res = clone(ChildMain, stack.data() + stack.size(),
+          CLONE_VM | CLONE_VFORK | SIGCHLD, &spawn_args);
+      clone_errno = errno;
+      pthread_sigmask(SIG_SETMASK, &spawn_args.signal_mask, nullptr);
+    } catch (const std::exception&) {
+      CloseFds(spawn_args);
+      ReleaseResources();
+      throw;
+    }
+    CloseFds(spawn_args);
+
+    if (res < 0) {
+      ReleaseResources();
+      throw std::runtime_error(std::string("clone() failed: ")
+          + strerror(clone_errno));
     }
+    pid_ = res;
+    if (spawn_args.failed_call != nullptr) {
+      waitpid(pid_, nullptr, 0);
+      ReleaseResources();
+      std::ostringstream s;
+      s << "failed to create process: " << spawn_args.failed_call
+          << " failed: " << strerror(spawn_args.error);
+      throw std::runtime_error(s.str());
+    }
+    state_ = ProcessState::RUNNING;
   }
   void SetArguments(const std::vector<std::string>& args) override {
     if (state_ != ProcessState::CREATED) {
@@ -114,6 +285,12 @@ class ProcessUnix : public Process {
     }
     output_ = path;
   }
+  void SetLimits(const ResourceLimits& limits) override {
+    if (state_ != ProcessState::CREATED) {
+      throw std::runtime_error("can't change limits after start");
+    }
+    limits_ = limits;
+  }
   int Wait() override {
     if (state_ != ProcessState::RUNNING) {
       throw std::runtime_error("process isn't running");
@@ -125,6 +302,7 @@ class ProcessUnix : public Process {
         throw std::runtime_error(strerror(errno));
       }
     }
+    ReleaseResources();
     if (WIFEXITED(status)) {
       return WEXITSTATUS(status);
     } else {
@@ -135,14 +313,54 @@ class ProcessUnix : public Process {
   ~ProcessUnix() {
     if (state_ == ProcessState::RUNNING) {
       kill(pid_, SIGTERM);
+      ReleaseResources();
     }
   }
 
  private:
+  // Creates a cgroup for the process, the child joins it before execve().
+  void CreateCgroup() {
+    cgroup_ = *limits_.cgroup / ("mr_" + std::to_string(getpid()) + "_"
+        + std::to_string(cgroup_count++));
+    std::filesystem::create_directory(*cgroup_);
+    if (limits_.memory.has_value()) {
+      std::ofstream memory_max(*cgroup_ / "memory.max");
+      memory_max << *limits_.memory << std::endl;
+      if (!memory_max) {
+        throw std::runtime_error("failed to set memory.max");
+      }
+    }
+  }
+
+  // Removes the cgroup and frees the CPU of a process that is gone.
+  void ReleaseResources() {
+    if (cgroup_.has_value()) {
+      std::error_code ec;
+      std::filesystem::remove(*cgroup_, ec);
+      cgroup_.reset();
+    }
+    if (cpu_.has_value()) {
+      CpuAllocator::Get().Release(*cpu_);
+      cpu_.reset();
+    }
+  }
+
+  static void CloseFds(const SpawnArgs& spawn_args) {
+    for (int fd : {spawn_args.input_fd, spawn_args.output_fd,
+        spawn_args.cgroup_procs_fd}) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
   std::string exec_;
   std::vector<std::string> args_;
   std::optional<std::string> input_;
   std::optional<std::string> output_;
+  ResourceLimits limits_;
+  std::optional<std::filesystem::path> cgroup_;
+  std::optional<int> cpu_;
   pid_t pid_;
   ProcessState state_;
 };
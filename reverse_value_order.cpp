@@ -0,0 +1,15 @@
+#include <algorithm>
+#include <cstring>
+#include "include/value_order.h"
+
+// Example value order plugin: byte order, reversed.
+// Usage: mapreduce reduce <exec> <input> <output> --value-order
+//     ./libreverse_value_order.so
+extern "C" int mr_compare_values(const char* a, size_t a_size,
+    const char* b, size_t b_size) {
+  int order = memcmp(a, b, std::min(a_size, b_size));
+  if (order == 0) {
+    order = (a_size > b_size) - (a_size < b_size);
+  }
+  return -order;
+}
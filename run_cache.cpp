@@ -0,0 +1,67 @@
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "include/lru_trim.h"
+#include "include/run_cache.h"
+
+namespace {
+
+// Hard links `from` to `to`, falls back to copying across filesystems.
+void LinkOrCopy(const std::filesystem::path& from,
+    const std::filesystem::path& to,
+    std::error_code& ec) {
+  std::filesystem::create_hard_link(from, to, ec);
+  if (ec && ec != std::errc::no_such_file_or_directory) {
+    std::filesystem::copy_file(from, to, ec);
+  }
+}
+
+}  // namespace
+
+RunCache::RunCache(const std::filesystem::path& dir, uintmax_t max_size) :
+    dir_(dir), max_size_(max_size) {
+  std::filesystem::create_directories(dir_);
+}
+
+bool RunCache::Restore(const std::string& key,
+    const std::filesystem::path& path) const {
+  auto cached_path = dir_ / key;
+  // `path` is left untouched on a miss, it may hold the input of the run
+  auto tmp_path = path;
+  tmp_path += ".cached";
+  std::filesystem::remove(tmp_path);
+  // no separate existence check: Trim() in another process may remove
+  // the entry at any moment, so a vanished entry is just a miss
+  std::error_code ec;
+  LinkOrCopy(cached_path, tmp_path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp_path);
+    if (ec == std::errc::no_such_file_or_directory) {
+      return false;
+    }
+    throw std::filesystem::filesystem_error("failed to restore cached file",
+        cached_path, tmp_path, ec);
+  }
+  std::filesystem::rename(tmp_path, path);
+  // atime marks the last use for Trim()
+  struct timespec times[2] = {{0, UTIME_NOW}, {0, UTIME_OMIT}};
+  utimensat(AT_FDCWD, cached_path.c_str(), times, 0);
+  return true;
+}
+
+void RunCache::Store(const std::string& key,
+    const std::filesystem::path& path) const {
+  auto tmp_path = dir_ / ('.' + key + '.' + std::to_string(getpid()));
+  std::filesystem::remove(tmp_path);
+  std::error_code ec;
+  LinkOrCopy(path, tmp_path, ec);
+  if (ec) {
+    throw std::filesystem::filesystem_error("failed to store file in cache",
+        path, tmp_path, ec);
+  }
+  std::filesystem::rename(tmp_path, dir_ / key);
+}
+
+void RunCache::Trim() const {
+  TrimDirectoryLru(dir_, max_size_);
+}
@@ -0,0 +1,258 @@
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "include/socket.h"
+
+namespace {
+
+constexpr size_t kFileFrameSize = 1 << 16;
+
+bool IsUnixAddress(const std::string& address) {
+  return address.find('/') != std::string::npos;
+}
+
+sockaddr_un MakeUnixAddress(const std::string& path) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    throw ConnectionError("socket path is too long: " + path);
+  }
+  memcpy(addr.sun_path, path.data(), path.size());
+  return addr;
+}
+
+// Resolves HOST:PORT, an empty HOST stands for the loopback interface.
+// The result must be freed with freeaddrinfo().
+addrinfo* ResolveTcpAddress(const std::string& address) {
+  size_t colon_pos = address.rfind(':');
+  if (colon_pos == std::string::npos) {
+    throw ConnectionError("address must be a path or HOST:PORT: " + address);
+  }
+  std::string host = address.substr(0, colon_pos);
+  std::string port = address.substr(colon_pos + 1);
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result;
+  int ret = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(),
+      &hints, &result);
+  if (ret != 0) {
+    throw ConnectionError("failed to resolve " + address + ": "
+        + gai_strerror(ret));
+  }
+  return result;
+}
+
+ConnectionError SocketError(const std::string& what,
+    const std::string& address) {
+  std::ostringstream ss;
+  ss << what << " " << address << ": " << strerror(errno);
+  return ConnectionError(ss.str());
+}
+
+}  // namespace
+
+Socket::Socket(int fd) : fd_(fd), unlink_path_() {}
+
+Socket Socket::Connect(const std::string& address) {
+  if (IsUnixAddress(address)) {
+    Socket s(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    auto addr = MakeUnixAddress(address);
+    if (s.fd_ < 0 || connect(s.fd_, reinterpret_cast<sockaddr*>(&addr),
+        sizeof(addr)) < 0) {
+      throw SocketError("failed to connect to", address);
+    }
+    return s;
+  }
+  addrinfo* addrs = ResolveTcpAddress(address);
+  for (addrinfo* ai = addrs; ai != nullptr; ai = ai->ai_next) {
+    Socket s(socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+        ai->ai_protocol));
+    if (s.fd_ >= 0 && connect(s.fd_, ai->ai_addr, ai->ai_addrlen) == 0) {
+      freeaddrinfo(addrs);
+      return s;
+    }
+  }
+  freeaddrinfo(addrs);
+  throw SocketError("failed to connect to", address);
+}
+
+Socket Socket::Listen(const std::string& address) {
+  if (IsUnixAddress(address)) {
+    Socket s(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0));
+    auto addr = MakeUnixAddress(address);
+    // only a stale socket may be replaced, never some other file
+    struct stat st;
+    if (lstat(address.c_str(), &st) == 0) {
+      if (!S_ISSOCK(st.st_mode)) {
+        throw std::runtime_error("failed to listen on " + address
+            + ": file exists and is not a socket");
+      }
+      unlink(address.c_str());
+    }
+    if (s.fd_ < 0
+        || bind(s.fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+      throw SocketError("failed to listen on", address);
+    }
+    s.unlink_path_ = address;
+    if (listen(s.fd_, SOMAXCONN) < 0) {
+      throw SocketError("failed to listen on", address);
+    }
+    return s;
+  }
+  addrinfo* addrs = ResolveTcpAddress(address);
+  for (addrinfo* ai = addrs; ai != nullptr; ai = ai->ai_next) {
+    Socket s(socket(ai->ai_family,
+        ai->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, ai->ai_protocol));
+    int one = 1;
+    if (s.fd_ >= 0
+        && setsockopt(s.fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == 0
+        && bind(s.fd_, ai->ai_addr, ai->ai_addrlen) == 0
+        && listen(s.fd_, SOMAXCONN) == 0) {
+      freeaddrinfo(addrs);
+      return s;
+    }
+  }
+  freeaddrinfo(addrs);
+  throw SocketError("failed to listen on", address);
+}
+
+std::optional<Socket> Socket::Accept(int stop_fd) const {
+  while (true) {
+    pollfd fds[2] = {{fd_, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("poll() failed: ")
+          + strerror(errno));
+    }
+    if (fds[1].revents != 0) {
+      return std::nullopt;
+    }
+    // the listener is non-blocking, as the connection may be gone by now;
+    // accepted sockets are blocking
+    int fd = accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd >= 0) {
+      return Socket(fd);
+    }
+    if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN
+        && errno != EWOULDBLOCK) {
+      throw std::runtime_error(std::string("accept() failed: ")
+          + strerror(errno));
+    }
+  }
+}
+
+void Socket::WriteFrame(const std::string& data) const {
+  if (data.size() > UINT32_MAX) {
+    throw std::runtime_error("frame is too large");
+  }
+  uint32_t size = data.size();
+  unsigned char header[4] = {
+    static_cast<unsigned char>(size >> 24),
+    static_cast<unsigned char>(size >> 16),
+    static_cast<unsigned char>(size >> 8),
+    static_cast<unsigned char>(size),
+  };
+  WriteAll(reinterpret_cast<char*>(header), sizeof(header));
+  WriteAll(data.data(), data.size());
+}
+
+std::string Socket::ReadFrame(size_t max_size) const {
+  unsigned char header[4];
+  ReadAll(reinterpret_cast<char*>(header), sizeof(header));
+  uint32_t size = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16)
+      | (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+  if (size > max_size) {
+    throw ConnectionError("frame of " + std::to_string(size)
+        + " bytes is over the limit of " + std::to_string(max_size));
+  }
+  std::string data(size, '\0');
+  ReadAll(data.data(), size);
+  return data;
+}
+
+void Socket::SendFile(const std::filesystem::path& path) const {
+  std::ifstream fin(path, std::ios::binary);
+  if (!fin.is_open()) {
+    std::ostringstream err;
+    err << "failed to open " << path << " for sending";
+    throw std::runtime_error(err.str());
+  }
+  std::string buf(kFileFrameSize, '\0');
+  while (fin.read(buf.data(), buf.size()) || fin.gcount() > 0) {
+    WriteFrame(buf.substr(0, fin.gcount()));
+  }
+  WriteFrame("");
+}
+
+void Socket::ReceiveFile(const std::filesystem::path& path) const {
+  std::ofstream fout(path, std::ios::binary);
+  if (!fout.is_open()) {
+    std::ostringstream err;
+    err << "failed to open " << path << " for receiving";
+    throw std::runtime_error(err.str());
+  }
+  std::string data;
+  while (!(data = ReadFrame(kFileFrameSize)).empty()) {
+    fout.write(data.data(), data.size());
+  }
+  fout.close();
+}
+
+Socket::Socket(Socket&& s) :
+    fd_(s.fd_), unlink_path_(std::move(s.unlink_path_)) {
+  s.fd_ = -1;
+  s.unlink_path_.clear();
+}
+
+Socket::~Socket() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  if (!unlink_path_.empty()) {
+    unlink(unlink_path_.c_str());
+  }
+}
+
+void Socket::WriteAll(const char* data, size_t size) const {
+  while (size > 0) {
+    // MSG_NOSIGNAL: a dead peer is an error, not a SIGPIPE
+    ssize_t cnt = send(fd_, data, size, MSG_NOSIGNAL);
+    if (cnt < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw ConnectionError(std::string("send() failed: ") + strerror(errno));
+    }
+    data += cnt;
+    size -= cnt;
+  }
+}
+
+void Socket::ReadAll(char* data, size_t size) const {
+  while (size > 0) {
+    ssize_t cnt = recv(fd_, data, size, 0);
+    if (cnt < 0 && errno == EINTR) {
+      continue;
+    }
+    if (cnt < 0) {
+      throw ConnectionError(std::string("recv() failed: ") + strerror(errno));
+    }
+    if (cnt == 0) {
+      throw ConnectionError("connection closed by peer");
+    }
+    data += cnt;
+    size -= cnt;
+  }
+}
@@ -0,0 +1,81 @@
+#include <unistd.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "include/process.h"
+
+// Measures process launches per second at different parent heap sizes,
+// comparing Process::Create() with a plain fork() + execvp().
+
+const char kExec[] = "true";
+
+double MeasureLaunchRate(size_t launches, void (*launch)()) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < launches; i++) {
+    launch();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return launches / elapsed.count();
+}
+
+void LaunchProcess() {
+  auto process = Process::Create(kExec);
+  process->Run();
+  if (process->Wait() != 0) {
+    throw std::runtime_error("process failed");
+  }
+}
+
+void LaunchFork() {
+  pid_t pid = fork();
+  if (pid < 0) {
+    throw std::runtime_error("fork() failed");
+  }
+  if (pid == 0) {
+    execlp(kExec, kExec, nullptr);
+    _exit(127);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    throw std::runtime_error("process failed");
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t launches = 200;
+  std::vector<size_t> heap_sizes_mb = {0, 64, 256, 1024};
+  if (argc > 1) {
+    launches = strtoul(argv[1], nullptr, 0);
+  }
+  if (argc > 2) {
+    heap_sizes_mb.clear();
+    for (int i = 2; i < argc; i++) {
+      heap_sizes_mb.push_back(strtoul(argv[i], nullptr, 0));
+    }
+  }
+  try {
+    std::cout << std::setw(10) << "heap, MiB"
+        << std::setw(16) << "Process/s"
+        << std::setw(16) << "fork+exec/s" << std::endl;
+    for (size_t heap_size_mb : heap_sizes_mb) {
+      // touched, so that the pages are actually mapped like sort buffers
+      std::vector<char> heap(heap_size_mb << 20);
+      memset(heap.data(), 1, heap.size());
+      double process_rate = MeasureLaunchRate(launches, LaunchProcess);
+      double fork_rate = MeasureLaunchRate(launches, LaunchFork);
+      std::cout << std::setw(10) << heap_size_mb
+          << std::setw(16) << std::fixed << std::setprecision(1)
+          << process_rate
+          << std::setw(16) << fork_rate << std::endl;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
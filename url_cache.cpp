@@ -0,0 +1,118 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include "include/fingerprint.h"
+#include "include/lru_trim.h"
+#include "include/url_cache.h"
+
+namespace {
+
+constexpr char kTmpPrefix[] = ".tmp.";
+// pages stored by one process between scans are at most 1/8 of the limit
+constexpr uintmax_t kScanFraction = 8;
+
+}  // namespace
+
+UrlCache::UrlCache(const std::filesystem::path& dir,
+    uintmax_t max_size,
+    std::optional<std::chrono::seconds> ttl) :
+    dir_(dir), max_size_(max_size), ttl_(ttl), known_size_(),
+    stored_since_scan_(0) {
+  std::filesystem::create_directories(dir_);
+}
+
+std::optional<std::string> UrlCache::Get(const std::string& url) const {
+  auto path = EntryPath(url);
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+  // mtime is the fetch time, atime is the last use
+  if (ttl_.has_value() && time(nullptr) - st.st_mtime > ttl_->count()) {
+    close(fd);
+    return std::nullopt;
+  }
+  std::string content;
+  if (st.st_size > 0) {
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      return std::nullopt;
+    }
+    content.assign(static_cast<const char*>(data), st.st_size);
+    munmap(data, st.st_size);
+  }
+  struct timespec times[2] = {{0, UTIME_NOW}, {0, UTIME_OMIT}};
+  futimens(fd, times);
+  close(fd);
+  return content;
+}
+
+void UrlCache::Put(const std::string& url, const std::string& content) {
+  auto path = EntryPath(url);
+  auto tmp_path = dir_ / (kTmpPrefix + path.filename().string()
+      + '.' + std::to_string(getpid()));
+  std::ofstream fout(tmp_path, std::ios::binary);
+  fout.write(content.data(), content.size());
+  fout.close();
+  if (!fout) {
+    std::filesystem::remove(tmp_path);
+    throw std::runtime_error("failed to write cache entry for " + url);
+  }
+  std::filesystem::rename(tmp_path, path);
+  stored_since_scan_ += content.size();
+  if (!known_size_.has_value()
+      || *known_size_ + stored_since_scan_ > max_size_
+      || stored_since_scan_ > max_size_ / kScanFraction) {
+    Evict();
+  }
+}
+
+std::string UrlCache::NormalizeUrl(const std::string& url) {
+  size_t begin = 0;
+  size_t end = url.size();
+  auto is_space = [](char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+  };
+  while (begin < end && is_space(url[begin])) {
+    ++begin;
+  }
+  while (end > begin && is_space(url[end - 1])) {
+    --end;
+  }
+  std::string result = url.substr(begin, end - begin);
+  size_t fragment_pos = result.find('#');
+  if (fragment_pos != std::string::npos) {
+    result.erase(fragment_pos);
+  }
+  // scheme and host are case-insensitive, the path is not
+  size_t host_begin = result.find("://");
+  host_begin = host_begin == std::string::npos ? 0 : host_begin + 3;
+  size_t host_end = std::min(result.find('/', host_begin), result.size());
+  std::transform(result.begin(), result.begin() + host_end, result.begin(),
+      [](unsigned char c) {
+        return std::tolower(c);
+      });
+  std::replace(result.begin() + host_end, result.end(), ' ', '_');
+  return result;
+}
+
+std::filesystem::path UrlCache::EntryPath(const std::string& url) const {
+  return dir_ / Fingerprint().Update(NormalizeUrl(url)).ToString();
+}
+
+void UrlCache::Evict() {
+  known_size_ = TrimDirectoryLru(dir_, max_size_);
+  stored_since_scan_ = 0;
+}
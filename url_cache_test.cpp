@@ -0,0 +1,205 @@
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <string>
+#include "include/tmpdir.h"
+#include "include/url_cache.h"
+
+// Offline checks of the wiki_url_map page cache.
+// Run without arguments to check UrlCache, or as
+//   url_cache_test put <dir> <url>
+// to store stdin as the page for <url> in the cache at <dir>.
+
+constexpr size_t kProcessCount = 4;
+constexpr size_t kPagesPerProcess = 50;
+constexpr size_t kPageSize = 1000;
+
+void Check(bool condition, const std::string& what) {
+  if (!condition) {
+    throw std::runtime_error("check failed: " + what);
+  }
+}
+
+// Names of the entries in `dir`, skipping the lock and temporary files.
+std::set<std::string> ListEntries(const std::filesystem::path& dir) {
+  std::set<std::string> entries;
+  for (const auto& dir_entry : std::filesystem::directory_iterator(dir)) {
+    std::string name = dir_entry.path().filename().string();
+    if (name[0] != '.') {
+      entries.insert(name);
+    }
+  }
+  return entries;
+}
+
+// Stores `content` for `url` and returns the path of the new entry.
+std::filesystem::path PutNew(UrlCache& cache,
+    const std::filesystem::path& dir,
+    const std::string& url,
+    const std::string& content) {
+  auto before = ListEntries(dir);
+  cache.Put(url, content);
+  for (const auto& name : ListEntries(dir)) {
+    if (before.count(name) == 0) {
+      return dir / name;
+    }
+  }
+  throw std::runtime_error("no entry was created for " + url);
+}
+
+// Moves access (atime) or modification (mtime) time of `path` to
+// `age` seconds ago.
+void MakeOlder(const std::filesystem::path& path, time_t age, bool access) {
+  struct timespec past = {time(nullptr) - age, 0};
+  struct timespec omit = {0, UTIME_OMIT};
+  struct timespec times[2] = {access ? past : omit, access ? omit : past};
+  if (utimensat(AT_FDCWD, path.c_str(), times, 0) < 0) {
+    throw std::runtime_error(std::string("utimensat() failed: ")
+        + strerror(errno));
+  }
+}
+
+void CheckNormalizeUrl() {
+  Check(UrlCache::NormalizeUrl(" HTTPS://En.Wikipedia.ORG/wiki/Big Cat#Diet\n")
+      == "https://en.wikipedia.org/wiki/Big_Cat", "scheme, host, fragment");
+  Check(UrlCache::NormalizeUrl("https://en.wikipedia.org/wiki/DNA")
+      == "https://en.wikipedia.org/wiki/DNA", "path case is kept");
+}
+
+void CheckGetPut(const std::filesystem::path& dir) {
+  UrlCache cache(dir, 1 << 20, std::nullopt);
+  Check(!cache.Get("https://en.wikipedia.org/wiki/Cat").has_value(),
+      "empty cache misses");
+  cache.Put("https://en.wikipedia.org/wiki/Cat", "cat page");
+  Check(cache.Get("https://EN.wikipedia.org/wiki/Cat#Senses") == "cat page",
+      "normalized URL hits");
+  cache.Put("https://en.wikipedia.org/wiki/Cat", "new cat page");
+  Check(cache.Get("https://en.wikipedia.org/wiki/Cat") == "new cat page",
+      "put replaces");
+  Check(ListEntries(dir).size() == 1, "one entry per URL");
+}
+
+void CheckTtl(const std::filesystem::path& dir) {
+  UrlCache cache(dir, 1 << 20, std::chrono::seconds(60));
+  auto fresh = PutNew(cache, dir, "https://en.wikipedia.org/wiki/Dog", "dog");
+  auto stale = PutNew(cache, dir, "https://en.wikipedia.org/wiki/Cow", "cow");
+  MakeOlder(fresh, 30, false);
+  MakeOlder(stale, 120, false);
+  Check(cache.Get("https://en.wikipedia.org/wiki/Dog") == "dog",
+      "entry within TTL hits");
+  Check(!cache.Get("https://en.wikipedia.org/wiki/Cow").has_value(),
+      "expired entry misses");
+  UrlCache no_ttl_cache(dir, 1 << 20, std::nullopt);
+  Check(no_ttl_cache.Get("https://en.wikipedia.org/wiki/Cow") == "cow",
+      "entries never expire without TTL");
+}
+
+void CheckLru(const std::filesystem::path& dir) {
+  UrlCache cache(dir, 30, std::nullopt);
+  PutNew(cache, dir, "https://en.wikipedia.org/wiki/A", std::string(10, 'a'));
+  auto b = PutNew(cache, dir, "https://en.wikipedia.org/wiki/B",
+      std::string(10, 'b'));
+  PutNew(cache, dir, "https://en.wikipedia.org/wiki/C", std::string(10, 'c'));
+  MakeOlder(b, 3600, true);
+  cache.Put("https://en.wikipedia.org/wiki/D", std::string(10, 'd'));
+  Check(!cache.Get("https://en.wikipedia.org/wiki/B").has_value(),
+      "least recently used entry is evicted");
+  for (const char* page : {"A", "C", "D"}) {
+    Check(cache.Get(std::string("https://en.wikipedia.org/wiki/") + page)
+        .has_value(), std::string("recently used entry is kept: ") + page);
+  }
+}
+
+std::string MakePage(size_t page_num) {
+  std::string page;
+  while (page.size() < kPageSize) {
+    page += "page " + std::to_string(page_num) + ' ';
+  }
+  page.resize(kPageSize);
+  return page;
+}
+
+// Processes store and read overlapping pages in a cache that only fits
+// part of them. Readers must never see a torn page and the cache must end
+// up within its limit.
+void CheckConcurrentProcesses(const std::filesystem::path& dir) {
+  // room for a third of all pages
+  constexpr uintmax_t kMaxSize =
+      kProcessCount * kPagesPerProcess * kPageSize / 3;
+  std::set<pid_t> children;
+  for (size_t process_num = 0; process_num < kProcessCount; ++process_num) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      throw std::runtime_error("fork() failed");
+    }
+    if (pid == 0) {
+      int retcode = 0;
+      try {
+        UrlCache cache(dir, kMaxSize, std::nullopt);
+        for (size_t i = 0; i < kPagesPerProcess; ++i) {
+          // half of the pages are shared with the other processes
+          size_t page_num = i % 2 == 0 ? i : process_num * 1000 + i;
+          std::string url = "https://en.wikipedia.org/wiki/"
+              + std::to_string(page_num);
+          auto page = cache.Get(url);
+          Check(!page.has_value() || *page == MakePage(page_num),
+              "concurrently stored page is complete");
+          cache.Put(url, MakePage(page_num));
+        }
+      } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        retcode = 1;
+      }
+      _exit(retcode);
+    }
+    children.insert(pid);
+  }
+  for (pid_t pid : children) {
+    int status;
+    waitpid(pid, &status, 0);
+    Check(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+        "concurrent process succeeded");
+  }
+  // the first Put() of a process scans the whole directory
+  UrlCache cache(dir, kMaxSize, std::nullopt);
+  cache.Put("https://en.wikipedia.org/wiki/0", MakePage(0));
+  uintmax_t total_size = 0;
+  for (const auto& name : ListEntries(dir)) {
+    total_size += std::filesystem::file_size(dir / name);
+  }
+  Check(total_size <= kMaxSize, "cache fits its limit");
+  for (const auto& dir_entry : std::filesystem::directory_iterator(dir)) {
+    Check(dir_entry.path().filename().string().rfind(".tmp.", 0) != 0,
+        "no temporary files are left");
+  }
+}
+
+int main(int argc, char** argv) {
+  try {
+    if (argc == 4 && std::string(argv[1]) == "put") {
+      UrlCache cache(argv[2], 256 << 20, std::nullopt);
+      cache.Put(argv[3], std::string(std::istreambuf_iterator<char>(std::cin),
+          std::istreambuf_iterator<char>()));
+      return 0;
+    } else if (argc != 1) {
+      std::cerr << "Usage: " << argv[0] << " [put <dir> <url>]" << std::endl;
+      return 1;
+    }
+    TmpDir tmpdir("url_cache_test_" + std::to_string(getpid()));
+    CheckNormalizeUrl();
+    CheckGetPut(tmpdir.GetPath() / "get_put");
+    CheckTtl(tmpdir.GetPath() / "ttl");
+    CheckLru(tmpdir.GetPath() / "lru");
+    CheckConcurrentProcesses(tmpdir.GetPath() / "concurrent");
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -1,32 +1,37 @@
 #include <iostream>
+#include <optional>
 #include <sstream>
 #include <string>
-#include <unordered_set>
 #include "include/key_value.h"
 
+// Expects values of the key sorted, as `mapreduce reduce --sort-values`
+// passes them: the empty marker value comes first and duplicate titles
+// are adjacent, so titles are written out as they arrive and memory use
+// does not depend on the size of the group.
 int main() {
   try {
-    TsvKeyValue kv, result;
-    std::unordered_set<std::string> titles;
+    TsvKeyValue kv;
+    std::optional<std::string> previous_value;
     bool had_empty_value = false;
+    bool had_titles = false;
     while (std::cin >> kv) {
-      if (kv.value.empty()) {
-        had_empty_value = true;
-        result.key = kv.key;
-      } else {
-        titles.insert(kv.value);
+      if (!previous_value.has_value()) {
+        had_empty_value = kv.value.empty();
+      } else if (kv.value < *previous_value) {
+        throw std::runtime_error("values are not sorted,"
+            " run reduce with --sort-values");
+      } else if (had_empty_value && kv.value != *previous_value) {
+        if (had_titles) {
+          std::cout << '#' << kv.value;
+        } else {
+          std::cout << TsvKeyValue(kv.key, kv.value);
+          had_titles = true;
+        }
       }
+      previous_value = std::move(kv.value);
     }
-    if (!had_empty_value) {
-      return 0;
-    }
-    for (const auto& title : titles) {
-      result.value.append(title);
-      result.value.push_back('#');
-    }
-    if (!titles.empty()) {
-      result.value.pop_back();
-      std::cout << result << std::endl;
+    if (had_titles) {
+      std::cout << std::endl;
     }
     return 0;
   } catch (const std::exception& e) {
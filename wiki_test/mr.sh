@@ -1,5 +1,6 @@
 #!/usr/bin/env bash
 set -e
+export WIKI_CACHE_DIR="${WIKI_CACHE_DIR:-cache}"
 ./build/mapreduce map ./build/wiki_url_map "$1" medium.txt -s 1
-./build/mapreduce reduce ./build/wiki_reduce <(cat medium.txt "$2") "$3"
+./build/mapreduce reduce ./build/wiki_reduce <(cat medium.txt "$2") "$3" --sort-values
 rm medium.txt
@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+# Checks of the wiki pipeline that need no network access.
+set -e
+cd "$(dirname "$0")"
+mkdir -p build/
+cd build/
+cmake ../../
+make
+cd ../
+
+echo " === page cache ==="
+./build/url_cache_test
+# a cached page is processed without fetching it
+rm -rf offline_cache
+url="https://en.wikipedia.org/wiki/Cat"
+echo '{"parse": {"displaytitle": "Cat", "text": {"*": "<p>The <b>cat</b> sat on a mat.</p>"}}}' \
+  | ./build/url_cache_test put offline_cache "$url"
+diff <(printf '%s\t\n' "$url" | WIKI_CACHE_DIR=offline_cache ./build/wiki_url_map) \
+  <(printf 'the\tCat\ncat\tCat\nsat\tCat\nmat\tCat\n')
+rm -r offline_cache
+# a cache that can't be created is skipped, not fatal
+WIKI_CACHE_DIR=/dev/null/cache ./build/wiki_url_map < /dev/null 2>/dev/null
+
+echo " === sorted values ==="
+# wiki_reduce dedupes titles in a streaming pass over sorted values
+./build/mapreduce reduce ./build/wiki_reduce data/medium.txt output.txt -s 16 --sort-values
+diff output.txt data/output.txt
+if ./build/mapreduce reduce ./build/wiki_reduce data/medium.txt output.txt 2>/dev/null
+then
+  echo "wiki_reduce accepted unsorted values"
+  exit 1
+fi
+./build/mapreduce reduce cat data/medium.txt output.txt -s 16 --value-order ./build/libreverse_value_order.so
+diff output.txt data/reversed.txt
+rm output.txt
+# values are only sorted for reducers
+if ./build/mapreduce map cat data/medium.txt output.txt --sort-values 2>/dev/null
+then
+  echo "map accepted --sort-values"
+  exit 1
+fi
@@ -1,9 +1,12 @@
 #include <json/value.h>
 #include <json/reader.h>
 #include <curl/curl.h>
+#include <cstdlib>
 #include <iostream>
+#include <optional>
 #include <regex>
 #include "include/key_value.h"
+#include "include/url_cache.h"
 using Json::operator>>;
 
 size_t CurlWriteCallback(char* data, size_t, size_t size, void* stream_ptr) {
@@ -20,9 +23,51 @@ const std::vector<std::regex> remove_sequence = {
   std::regex("&#\\d+"),
 };
 
+// Page cache is configured through the environment since mappers get no
+// arguments:
+//   WIKI_CACHE_DIR    directory to keep fetched pages in (no caching if unset)
+//   WIKI_CACHE_SIZE   cache size limit in bytes, 256 MiB by default
+//   WIKI_CACHE_TTL    refetch pages cached more than this many seconds ago
+// The cache is only an optimisation: if it can't be set up or written to,
+// the error is reported and pages are fetched without it.
+std::optional<UrlCache> CreateCacheFromEnv() {
+  const char* dir = std::getenv("WIKI_CACHE_DIR");
+  if (dir == nullptr || *dir == '\0') {
+    return std::nullopt;
+  }
+  uintmax_t max_size = 256 << 20;
+  if (const char* size = std::getenv("WIKI_CACHE_SIZE")) {
+    max_size = std::stoull(size);
+  }
+  std::optional<std::chrono::seconds> ttl;
+  if (const char* ttl_str = std::getenv("WIKI_CACHE_TTL")) {
+    ttl = std::chrono::seconds(std::stoll(ttl_str));
+  }
+  try {
+    return std::make_optional<UrlCache>(dir, max_size, ttl);
+  } catch (const std::exception& e) {
+    std::cerr << "page cache disabled: " << e.what() << std::endl;
+    return std::nullopt;
+  }
+}
+
+std::string FetchPage(CURL* session, const std::string& url) {
+  std::ostringstream stream;
+  curl_easy_setopt(session, CURLOPT_URL, url.data());
+  curl_easy_setopt(session, CURLOPT_WRITEFUNCTION, CurlWriteCallback);
+  curl_easy_setopt(session, CURLOPT_WRITEDATA, &stream);
+  CURLcode result_code = curl_easy_perform(session);
+  curl_easy_reset(session);
+  if (result_code != CURLE_OK) {
+    throw std::runtime_error(curl_easy_strerror(result_code));
+  }
+  return stream.str();
+}
+
 int main() {
   CURL* session = curl_easy_init();
   try {
+    auto cache = CreateCacheFromEnv();
     TsvKeyValue kv;
     while (std::cin >> kv) {
       std::ostringstream url_stream;
@@ -33,18 +78,27 @@ int main() {
           "/w/api.php?action=parse&redirects=true&prop=text|displaytitle"
               "&format=json&page=");
       try {
-        std::stringstream stream;
-        curl_easy_setopt(session, CURLOPT_URL, url_stream.str().data());
-        curl_easy_setopt(session, CURLOPT_WRITEFUNCTION, CurlWriteCallback);
-        curl_easy_setopt(session, CURLOPT_WRITEDATA, &stream);
-        CURLcode result_code = curl_easy_perform(session);
-        if (result_code != CURLE_OK) {
-          throw std::runtime_error(curl_easy_strerror(result_code));
+        std::optional<std::string> page;
+        if (cache.has_value()) {
+          page = cache->Get(kv.key);
+        }
+        bool fetched = !page.has_value();
+        if (fetched) {
+          page = FetchPage(session, url_stream.str());
         }
-        curl_easy_reset(session);
 
+        std::stringstream stream(*page);
         Json::Value value;
         stream >> value;
+        // only pages that parsed are worth keeping
+        if (fetched && cache.has_value()) {
+          try {
+            cache->Put(kv.key, *page);
+          } catch (const std::exception& e) {
+            std::cerr << "page cache disabled: " << e.what() << std::endl;
+            cache.reset();
+          }
+        }
         std::string page_text = value["parse"]["text"]["*"].asString();
         std::string page_title = value["parse"]["displaytitle"].asString();
         std::replace(page_text.begin(), page_text.end(), '\n', ' ');
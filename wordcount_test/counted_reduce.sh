@@ -0,0 +1,20 @@
+#!/usr/bin/env bash
+# wordcount_reduce that records in concurrency_max the highest number of
+# its copies running at once
+set -e
+update_count() {
+  (
+    flock 9
+    count=$(($(cat concurrency_count 2>/dev/null || echo 0) + $1))
+    echo $count > concurrency_count
+    if [ "$count" -gt "$(cat concurrency_max 2>/dev/null || echo 0)" ]
+    then
+      echo $count > concurrency_max
+    fi
+  ) 9>concurrency.lock
+}
+update_count 1
+# long enough for the other tasks to start if they are allowed to
+sleep 0.2
+./build/wordcount_reduce
+update_count -1
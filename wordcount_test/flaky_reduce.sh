@@ -0,0 +1,9 @@
+#!/usr/bin/env bash
+# wordcount_reduce that fails on its third run while flaky_fail exists
+count=$(cat flaky_count 2>/dev/null || echo 0)
+echo $((count + 1)) > flaky_count
+if [ -e flaky_fail ] && [ "$count" -eq 2 ]
+then
+  exit 1
+fi
+exec ./build/wordcount_reduce
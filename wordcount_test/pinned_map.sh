@@ -0,0 +1,4 @@
+#!/usr/bin/env bash
+# wordcount_map that fails unless it is pinned to a single CPU
+[ "$(nproc)" -eq 1 ] || exit 1
+exec ./build/wordcount_map
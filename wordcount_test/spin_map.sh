@@ -0,0 +1,7 @@
+#!/usr/bin/env bash
+# mapper that burns CPU time for 10 seconds and then succeeds, unless
+# a CPU time limit stops it first
+while [ $SECONDS -lt 10 ]
+do
+  :
+done
@@ -7,6 +7,17 @@ cmake ../../
 make
 cd ../
 
+# two local worker daemons for the distributed runs
+allowed_execs="./build/wordcount_map ./build/wordcount_reduce"
+./build/mapreduce worker "$PWD/worker.sock" $allowed_execs &
+unix_worker=$!
+./build/mapreduce worker :47011 $allowed_execs &
+tcp_worker=$!
+trap 'kill $unix_worker $tcp_worker 2>/dev/null' EXIT
+sleep 1
+workers="-w $PWD/worker.sock -w :47011"
+dead_workers="-w $PWD/dead1.sock -w $PWD/dead2.sock -w $PWD/dead3.sock"
+
 i=1
 while [ -r data/input$i.txt ] && [ -r data/medium$i.txt ] && [ -r data/output$i.txt ]
 do
@@ -17,5 +28,107 @@ do
   diff <(sort output.txt) <(sort data/output$i.txt)
   rm medium.txt
   rm output.txt
+  # second pass reuses everything cached by the first one: no entry is
+  # added or stored again, so names and inodes stay the same
+  for pass in cold warm
+  do
+    cached=$(ls -i cache 2>/dev/null || true)
+    ./build/mapreduce map ./build/wordcount_map data/input$i.txt medium.txt -s 256 -c cache
+    ./build/mapreduce reduce ./build/wordcount_reduce medium.txt output.txt -s 256 -c cache
+    diff <(sort medium.txt) <(sort data/medium$i.txt)
+    diff <(sort output.txt) <(sort data/output$i.txt)
+    rm medium.txt
+    rm output.txt
+  done
+  test -n "$cached"
+  test "$cached" == "$(ls -i cache)"
+  # a zero size limit evicts everything after use
+  ./build/mapreduce map ./build/wordcount_map data/input$i.txt medium.txt -s 256 -c small_cache --cache-size 0
+  ./build/mapreduce reduce ./build/wordcount_reduce medium.txt output.txt -s 256 -c small_cache --cache-size 0
+  diff <(sort output.txt) <(sort data/output$i.txt)
+  test -z "$(ls small_cache)"
+  rm -r small_cache
+  rm medium.txt
+  rm output.txt
+  # second pass finds every input kept by the worker it is sent to, so
+  # nothing is received and kept again
+  for pass in cold warm
+  do
+    kept=$(ls -i mr_worker_*/inputs 2>/dev/null || true)
+    ./build/mapreduce map ./build/wordcount_map data/input$i.txt medium.txt -s 256 $workers
+    ./build/mapreduce reduce ./build/wordcount_reduce medium.txt output.txt $workers
+    diff <(sort medium.txt) <(sort data/medium$i.txt)
+    diff <(sort output.txt) <(sort data/output$i.txt)
+    rm medium.txt
+    rm output.txt
+  done
+  test -n "$kept"
+  test "$kept" == "$(ls -i mr_worker_*/inputs)"
+  # tasks of workers that can't be reached move to the live ones
+  ./build/mapreduce map ./build/wordcount_map data/input$i.txt medium.txt -s 1 $dead_workers $workers 2>worker_errors.txt
+  ./build/mapreduce reduce ./build/wordcount_reduce medium.txt output.txt $dead_workers $workers 2>>worker_errors.txt
+  grep -q "rescheduling chunk" worker_errors.txt
+  diff <(sort medium.txt) <(sort data/medium$i.txt)
+  diff <(sort output.txt) <(sort data/output$i.txt)
+  rm output.txt
+  # a task the workers reject fails the job without marking them dead
+  if ./build/mapreduce map cat data/input$i.txt medium.txt $workers 2>worker_errors.txt
+  then
+    echo "workers ran an executable that is not allowed"
+    exit 1
+  fi
+  grep -q "executable is not allowed" worker_errors.txt
+  rm medium.txt worker_errors.txt
+  # one reduce task fails, the resumed run redoes only that task
+  ./build/mapreduce map ./build/wordcount_map data/input$i.txt medium.txt
+  touch flaky_fail
+  rm -f flaky_count
+  if ./build/mapreduce reduce ./flaky_reduce.sh medium.txt output.txt -p 1 --resume job 2>/dev/null
+  then
+    echo "flaky reduce did not fail"
+    exit 1
+  fi
+  [ -r job/journal ]
+  rm flaky_fail
+  echo 0 > flaky_count
+  ./build/mapreduce reduce ./flaky_reduce.sh medium.txt output.txt -p 1 --resume job
+  [ "$(cat flaky_count)" -eq 1 ]
+  [ ! -e job ]
+  diff <(sort output.txt) <(sort data/output$i.txt)
+  rm medium.txt output.txt flaky_count
   let i+=1
 done
+rm -r cache
+
+# stopped workers remove their socket and work directory
+kill $unix_worker $tcp_worker
+wait $unix_worker $tcp_worker
+trap - EXIT
+[ ! -e worker.sock ]
+[ -z "$(ls -d mr_worker_* 2>/dev/null)" ]
+
+echo " === resource limits ==="
+# the budget fits a single task, so they run one at a time despite -p
+rm -f concurrency_count concurrency_max
+./build/mapreduce reduce ./counted_reduce.sh data/medium1.txt output.txt -p 4 -m $((16 << 20))
+diff <(sort output.txt) <(sort data/output1.txt)
+[ "$(cat concurrency_max)" -eq 1 ]
+# without it they overlap
+rm -f concurrency_count concurrency_max
+./build/mapreduce reduce ./counted_reduce.sh data/medium1.txt output.txt -p 4
+diff <(sort output.txt) <(sort data/output1.txt)
+[ "$(cat concurrency_max)" -gt 1 ]
+rm output.txt concurrency_count concurrency_max concurrency.lock
+if ./build/mapreduce map ./build/wordcount_map data/input1.txt medium.txt -l $((1 << 20)) 2>/dev/null
+then
+  echo "mapper ran in 1 MiB of address space"
+  exit 1
+fi
+if ./build/mapreduce map ./spin_map.sh data/input1.txt medium.txt -t 1 2>/dev/null
+then
+  echo "mapper outran its CPU time limit"
+  exit 1
+fi
+./build/mapreduce map ./pinned_map.sh data/input1.txt medium.txt --pin
+diff <(sort medium.txt) <(sort data/medium1.txt)
+rm medium.txt
@@ -0,0 +1,267 @@
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "include/fingerprint.h"
+#include "include/lru_trim.h"
+#include "include/process.h"
+#include "include/socket.h"
+#include "include/tmpdir.h"
+#include "include/worker.h"
+
+namespace {
+
+constexpr size_t kMaxArgCount = 1 << 10;
+constexpr uintmax_t kInputStoreSize = uintmax_t(1) << 30;
+
+// write end of the pipe that stops the accept loop, see OnStopSignal()
+int stop_pipe_write_fd = -1;
+
+void OnStopSignal(int) {
+  int saved_errno = errno;
+  char byte = 0;
+  ssize_t ret = write(stop_pipe_write_fd, &byte, 1);
+  (void) ret;
+  errno = saved_errno;
+}
+
+// Counts running tasks, so that connections beyond the limit wait in
+// the listen backlog instead of each getting a thread.
+class TaskSlots {
+ public:
+  explicit TaskSlots(size_t count) :
+      count_(count), free_(count), mutex_(), cv_() {}
+
+  void Acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() {
+      return free_ > 0;
+    });
+    --free_;
+  }
+
+  void Release() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++free_;
+    }
+    cv_.notify_all();
+  }
+
+  void WaitForAll() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() {
+      return free_ == count_;
+    });
+  }
+
+ private:
+  size_t count_;
+  size_t free_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+// Inputs of earlier tasks, named by their fingerprints and evicted in LRU
+// order. Entries are hard linked into task directories, so eviction never
+// pulls an input from under a running task.
+class InputStore {
+ public:
+  explicit InputStore(const std::filesystem::path& dir) : dir_(dir) {
+    std::filesystem::create_directory(dir_);
+  }
+
+  // Links the input with `fingerprint` to `path`, returns false if there
+  // is no such input.
+  bool Take(const std::string& fingerprint,
+      const std::filesystem::path& path) const {
+    auto stored_path = dir_ / fingerprint;
+    std::error_code ec;
+    std::filesystem::create_hard_link(stored_path, path, ec);
+    if (ec) {
+      return false;
+    }
+    // atime marks the last use for eviction
+    struct timespec times[2] = {{0, UTIME_NOW}, {0, UTIME_OMIT}};
+    utimensat(AT_FDCWD, stored_path.c_str(), times, 0);
+    return true;
+  }
+
+  // Keeps the received input at `path` if it really has `fingerprint`.
+  // The store is only an optimisation, so failing to keep it is no error.
+  void Keep(const std::string& fingerprint,
+      const std::filesystem::path& path) const {
+    try {
+      if (Fingerprint().UpdateFile(path).ToString() != fingerprint) {
+        return;
+      }
+      auto tmp_path = dir_ / ('.' + path.parent_path().filename().string());
+      std::filesystem::remove(tmp_path);
+      std::filesystem::create_hard_link(path, tmp_path);
+      std::filesystem::rename(tmp_path, dir_ / fingerprint);
+      TrimDirectoryLru(dir_, kInputStoreSize);
+    } catch (const std::exception& e) {
+      std::cerr << "input not kept: " << e.what() << std::endl;
+    }
+  }
+
+ private:
+  std::filesystem::path dir_;
+};
+
+// Fingerprints come from unauthenticated peers and name files.
+bool IsFingerprint(const std::string& data) {
+  return data.size() == 16 && std::all_of(data.begin(), data.end(),
+      [](unsigned char c) {
+        return std::isdigit(c) || (c >= 'a' && c <= 'f');
+      });
+}
+
+// Identifies an executable the same way regardless of how its path
+// was spelled. Names without '/' are looked up in PATH and stay as is.
+std::string NormalizeExec(const std::string& exec) {
+  if (exec.find('/') == std::string::npos) {
+    return exec;
+  }
+  return std::filesystem::weakly_canonical(exec).string();
+}
+
+std::optional<size_t> ReadOptionalFrame(const Socket& socket) {
+  std::string data = socket.ReadFrame();
+  if (data.empty()) {
+    return std::nullopt;
+  }
+  return std::stoul(data);
+}
+
+void HandleTask(Socket socket,
+    const std::filesystem::path& task_dir,
+    const InputStore* inputs,
+    const std::vector<std::string>& allowed_execs,
+    TaskSlots* slots) {
+  try {
+    if (socket.ReadFrame() != "run") {
+      throw std::runtime_error("unknown request");
+    }
+    // the whole request is read before it is judged, so that a rejection
+    // never races with the coordinator still sending
+    std::string exec = socket.ReadFrame();
+    size_t arg_count = std::stoul(socket.ReadFrame());
+    if (arg_count > kMaxArgCount) {
+      throw std::runtime_error("too many arguments");
+    }
+    std::vector<std::string> args(arg_count);
+    for (auto& arg : args) {
+      arg = socket.ReadFrame();
+    }
+    ResourceLimits limits;
+    limits.memory = ReadOptionalFrame(socket);
+    limits.cpu_time = ReadOptionalFrame(socket);
+    limits.pin_cpu = socket.ReadFrame() == "1";
+    bool has_output = socket.ReadFrame() == "1";
+    // fingerprint of the input, empty if there is none
+    std::string input = socket.ReadFrame();
+    if (!input.empty() && !IsFingerprint(input)) {
+      throw std::runtime_error("malformed input fingerprint");
+    }
+    if (std::find(allowed_execs.begin(), allowed_execs.end(),
+        NormalizeExec(exec)) == allowed_execs.end()) {
+      throw std::runtime_error("executable is not allowed: " + exec);
+    }
+    auto process = Process::Create(exec);
+    process->SetArguments(args);
+    process->SetLimits(limits);
+    if (!input.empty()) {
+      if (inputs->Take(input, task_dir / "input")) {
+        socket.WriteFrame("ready");
+      } else {
+        socket.WriteFrame("send");
+        socket.ReceiveFile(task_dir / "input");
+        inputs->Keep(input, task_dir / "input");
+      }
+      process->SetInput(task_dir / "input");
+    } else {
+      socket.WriteFrame("ready");
+    }
+    if (has_output) {
+      process->SetOutput(task_dir / "output");
+    }
+    process->Run();
+    int retcode = process->Wait();
+    socket.WriteFrame("exit");
+    socket.WriteFrame(std::to_string(retcode));
+    if (has_output) {
+      socket.SendFile(task_dir / "output");
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "task failed: " << e.what() << std::endl;
+    try {
+      socket.WriteFrame("error");
+      socket.WriteFrame(std::string(e.what()).substr(0,
+          Socket::kMaxControlFrameSize));
+    } catch (const std::exception&) {
+      // the coordinator is gone, nobody to report to
+    }
+  }
+  std::filesystem::remove_all(task_dir);
+  slots->Release();
+}
+
+}  // namespace
+
+void RunWorker(const std::string& address,
+    const std::vector<std::string>& allowed_execs) {
+  std::vector<std::string> normalized_execs;
+  for (const auto& exec : allowed_execs) {
+    normalized_execs.push_back(NormalizeExec(exec));
+  }
+  int stop_pipe[2];
+  if (pipe2(stop_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+    throw std::runtime_error(std::string("pipe2() failed: ")
+        + strerror(errno));
+  }
+  stop_pipe_write_fd = stop_pipe[1];
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = OnStopSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGTERM, &action, nullptr);
+  sigaction(SIGINT, &action, nullptr);
+
+  auto listener = Socket::Listen(address);
+  TmpDir workdir("mr_worker_" + std::to_string(getpid()));
+  InputStore inputs(workdir.GetPath() / "inputs");
+  TaskSlots slots(std::max(1u, std::thread::hardware_concurrency()) * 2);
+  try {
+    for (size_t task_num = 0;; task_num++) {
+      slots.Acquire();
+      auto connection = listener.Accept(stop_pipe[0]);
+      if (!connection.has_value()) {
+        slots.Release();
+        break;
+      }
+      auto task_dir = workdir.GetPath() / std::to_string(task_num);
+      std::filesystem::create_directory(task_dir);
+      // tasks are detached, so they get their own copy of the list
+      std::thread(HandleTask, std::move(*connection), task_dir, &inputs,
+          normalized_execs, &slots).detach();
+    }
+  } catch (...) {
+    slots.WaitForAll();
+    throw;
+  }
+  // running tasks finish before their directories go away
+  slots.WaitForAll();
+  close(stop_pipe[0]);
+  close(stop_pipe[1]);
+}